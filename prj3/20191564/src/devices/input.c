@@ -1,16 +1,44 @@
 #include "devices/input.h"
 #include <debug.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/synch.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Line discipline.
+   input_read() takes keys out of BUFFER into LINE and hands them
+   out from there.  In cooked mode it collects a whole line
+   first: keys are echoed to the console, backspace and Ctrl+U
+   edit the line, and Enter or Ctrl+D finishes it.  In raw mode,
+   the default, it takes whatever keys are waiting, at least one,
+   without echo or editing, as reads of the console always did.
+   Interactive programs such as the shell switch to cooked mode
+   with the ttyraw system call.  Either way, what is in LINE is
+   returned across as many input_read() calls as it takes. */
+#define LINE_MAX 256
+static uint8_t line[LINE_MAX];
+static size_t line_len;         /* Number of bytes in LINE. */
+static size_t line_ofs;         /* Bytes of LINE already returned. */
+static bool raw_mode;           /* Raw mode instead of cooked? */
+static struct lock read_lock;   /* One reader at a time. */
+
+#define CTRL(C) ((C) - 'A' + 1)
+
+static void read_cooked (void);
+static void read_raw (void);
+static bool erase (void);
+
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
   intq_init (&buffer);
+  lock_init (&read_lock);
+  raw_mode = true;
 }
 
 /* Adds a key to the input buffer.
@@ -50,3 +78,105 @@ input_full (void)
   ASSERT (intr_get_level () == INTR_OFF);
   return intq_full (&buffer);
 }
+
+/* Reads up to SIZE bytes of input into BUF, through the line
+   discipline, and returns the number of bytes read.  In cooked
+   mode, returns 0 if the user ends an empty line with Ctrl+D. */
+size_t
+input_read (uint8_t *buf, size_t size) 
+{
+  size_t n;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&read_lock);
+  if (line_ofs >= line_len)
+    {
+      line_len = line_ofs = 0;
+      if (raw_mode)
+        read_raw ();
+      else
+        read_cooked ();
+    }
+
+  n = line_len - line_ofs;
+  if (n > size)
+    n = size;
+  memcpy (buf, line + line_ofs, n);
+  line_ofs += n;
+  lock_release (&read_lock);
+
+  return n;
+}
+
+/* Switches the line discipline to raw mode if RAW is true,
+   otherwise to cooked mode.  Returns true if it was in raw mode
+   before. */
+bool
+input_set_raw (bool raw) 
+{
+  bool old_raw = raw_mode;
+  raw_mode = raw;
+  return old_raw;
+}
+
+/* Collects one edited line of input in LINE, echoing it. */
+static void
+read_cooked (void) 
+{
+  for (;;)
+    {
+      uint8_t c = input_getc ();
+
+      if (c == '\r' || c == '\n')
+        {
+          line[line_len++] = '\n';
+          putchar ('\n');
+          return;
+        }
+      else if (c == CTRL ('D'))
+        return;
+      else if (c == '\b' || c == 0x7f)
+        erase ();
+      else if (c == CTRL ('U'))
+        {
+          while (erase ())
+            continue;
+        }
+      else if (line_len < LINE_MAX - 1)
+        {
+          /* The last byte of LINE is kept for the new-line. */
+          line[line_len++] = c;
+          putchar (c);
+        }
+    }
+}
+
+/* Takes the keys waiting in the input buffer into LINE, waiting
+   for one if there are none. */
+static void
+read_raw (void) 
+{
+  enum intr_level old_level;
+
+  line[line_len++] = input_getc ();
+
+  old_level = intr_disable ();
+  while (line_len < LINE_MAX && !intq_empty (&buffer))
+    line[line_len++] = intq_getc (&buffer);
+  serial_notify ();
+  intr_set_level (old_level);
+}
+
+/* Removes the last character from the line being collected, and
+   from the screen.  Returns false if the line was empty. */
+static bool
+erase (void) 
+{
+  if (line_len == 0)
+    return false;
+  line_len--;
+  putbuf ("\b \b", 3);
+  return true;
+}
@@ -2,11 +2,14 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
 bool input_full (void);
+size_t input_read (uint8_t *, size_t);
+bool input_set_raw (bool);
 
 #endif /* devices/input.h */
@@ -2,16 +2,30 @@
 #include <debug.h>
 #include "threads/thread.h"
 
-static int next (int pos);
+static int next (const struct intq *q, int pos);
 static void wait (struct intq *q, struct thread **waiter);
 static void signal (struct intq *q, struct thread **waiter);
 
-/* Initializes interrupt queue Q. */
+/* Initializes interrupt queue Q, with room for INTQ_BUFSIZE - 1
+   bytes. */
 void
 intq_init (struct intq *q) 
 {
+  intq_init_buffer (q, q->default_buf, INTQ_BUFSIZE);
+}
+
+/* Initializes interrupt queue Q to keep its data in the SIZE
+   bytes at BUF, with room for SIZE - 1 bytes. */
+void
+intq_init_buffer (struct intq *q, uint8_t *buf, int size) 
+{
+  ASSERT (buf != NULL);
+  ASSERT (size > 1);
+
   lock_init (&q->lock);
   q->not_full = q->not_empty = NULL;
+  q->buf = buf;
+  q->size = size;
   q->head = q->tail = 0;
 }
 
@@ -28,7 +42,7 @@ bool
 intq_full (const struct intq *q) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return next (q->head) == q->tail;
+  return next (q, q->head) == q->tail;
 }
 
 /* Removes a byte from Q and returns it.
@@ -49,7 +63,7 @@ intq_getc (struct intq *q)
     }
   
   byte = q->buf[q->tail];
-  q->tail = next (q->tail);
+  q->tail = next (q, q->tail);
   signal (q, &q->not_full);
   return byte;
 }
@@ -70,15 +84,15 @@ intq_putc (struct intq *q, uint8_t byte)
     }
 
   q->buf[q->head] = byte;
-  q->head = next (q->head);
+  q->head = next (q, q->head);
   signal (q, &q->not_empty);
 }
 
-/* Returns the position after POS within an intq. */
+/* Returns the position after POS within Q. */
 static int
-next (int pos) 
+next (const struct intq *q, int pos) 
 {
-  return (pos + 1) % INTQ_BUFSIZE;
+  return (pos + 1) % q->size;
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
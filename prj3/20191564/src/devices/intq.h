@@ -17,7 +17,8 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
+/* Queue buffer size, in bytes, unless the queue is given its own
+   buffer with intq_init_buffer(). */
 #define INTQ_BUFSIZE 64
 
 /* A circular queue of bytes. */
@@ -29,12 +30,15 @@ struct intq
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
     /* Queue. */
-    uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
+    uint8_t *buf;               /* Buffer, SIZE bytes. */
+    int size;                   /* Buffer size; holds SIZE - 1 bytes. */
     int head;                   /* New data is written here. */
     int tail;                   /* Old data is read here. */
+    uint8_t default_buf[INTQ_BUFSIZE]; /* BUF, by default. */
   };
 
 void intq_init (struct intq *);
+void intq_init_buffer (struct intq *, uint8_t *buf, int size);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
@@ -1,5 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <stdio.h>
 #include "devices/input.h"
 #include "devices/intq.h"
 #include "devices/timer.h"
@@ -7,6 +8,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* Register definitions for the 16550A UART used in PCs.
    The 16550A has a lot more going on than shown here, but this
@@ -33,6 +35,14 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* FIFOs are enabled (16550A only). */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -47,15 +57,34 @@
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
 #define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_TEMT 0x40           /* Transmitter Empty: all bits sent. */
+
+/* Depth of the 16550A's transmit FIFO. */
+#define FIFO_SIZE 16
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
+/* Data to be transmitted.  The queue is much bigger than other
+   interrupt queues, so that it holds many FIFO bursts. */
+#define TXQ_SIZE 1024
 static struct intq txq;
+static uint8_t txq_buf[TXQ_SIZE];
+
+/* Number of bytes that may be written to THR each time it is
+   empty: FIFO_SIZE if the UART has a working FIFO, otherwise 1. */
+static int tx_burst;
+
+/* Current speed, in bits per second. */
+static int serial_bps = 9600;
+
+/* Statistics. */
+static int64_t tx_cnt;          /* Bytes transmitted. */
+static int64_t tx_intr_cnt;     /* Transmit interrupts that sent bytes. */
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void putq_poll (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +97,11 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
-  set_serial (9600);                    /* 9.6 kbps, N-8-1. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
+  tx_burst = (inb (IIR_REG) & IIR_FIFO) == IIR_FIFO ? FIFO_SIZE : 1;
+  set_serial (serial_bps);              /* 9.6 kbps by default, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  intq_init_buffer (&txq, txq_buf, sizeof txq_buf);
   mode = POLL;
 } 
 
@@ -117,9 +147,9 @@ serial_putc (uint8_t byte)
           /* Interrupts are off and the transmit queue is full.
              If we wanted to wait for the queue to empty,
              we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+             That's impolite, so we'll send some characters
+             via polling instead. */
+          putq_poll (); 
         }
 
       intq_putc (&txq, byte); 
@@ -129,6 +159,59 @@ serial_putc (uint8_t byte)
   intr_set_level (old_level);
 }
 
+/* Sends the N bytes in BUFFER to the serial port.
+   Like calling serial_putc() on each byte, but with interrupts
+   disabled only once, and the interrupt enable register is
+   updated only when the transmit queue fills up and at the end.
+   BUFFER must be kernel memory: it is read with interrupts off,
+   where a page fault could not be serviced. */
+void
+serial_write (const uint8_t *buffer, size_t n) 
+{
+  enum intr_level old_level;
+
+  ASSERT (n == 0 || is_kernel_vaddr (buffer));
+  old_level = intr_disable ();
+
+  if (mode != QUEUE)
+    {
+      if (mode == UNINIT)
+        init_poll ();
+      while (n > 0)
+        {
+          /* Once THR is empty, the FIFO takes a burst. */
+          int i;
+          putc_poll (*buffer++);
+          n--;
+          for (i = 1; i < tx_burst && n > 0; i++, n--)
+            {
+              outb (THR_REG, *buffer++);
+              tx_cnt++;
+            }
+        }
+    }
+  else 
+    {
+      while (n-- > 0)
+        {
+          if (intq_full (&txq)) 
+            {
+              /* As in serial_putc(), poll a byte out if we can't
+                 wait.  Otherwise make sure the transmit interrupt
+                 is on to drain the queue while intq_putc() waits. */
+              if (old_level == INTR_OFF)
+                putq_poll ();
+              else
+                write_ier ();
+            }
+          intq_putc (&txq, *buffer++);
+        }
+      write_ier ();
+    }
+
+  intr_set_level (old_level);
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
@@ -136,10 +219,47 @@ serial_flush (void)
 {
   enum intr_level old_level = intr_disable ();
   while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+    putq_poll ();
   intr_set_level (old_level);
 }
 
+/* Changes the serial port to SPEED bits per second, once
+   everything already queued has been sent at the old speed.
+   Returns false, without changing anything, if the UART can't
+   run at exactly SPEED. */
+bool
+serial_set_speed (int speed) 
+{
+  enum intr_level old_level;
+
+  if (speed < 300 || speed > 115200 || 115200 % speed != 0)
+    return false;
+
+  old_level = intr_disable ();
+  if (mode == UNINIT)
+    init_poll ();
+  while (!intq_empty (&txq))
+    putq_poll ();
+  while ((inb (LSR_REG) & LSR_TEMT) == 0)
+    continue;
+  serial_bps = speed;
+  set_serial (serial_bps);
+  intr_set_level (old_level);
+
+  return true;
+}
+
+/* Prints serial port statistics. */
+void
+serial_print_stats (void) 
+{
+  int64_t ticks = timer_ticks ();
+  printf ("Serial: %lld characters sent at %d bps, %lld per second, "
+          "%lld transmit interrupts\n",
+          tx_cnt, serial_bps, ticks > 0 ? tx_cnt * TIMER_FREQ / ticks : 0,
+          tx_intr_cnt);
+}
+
 /* The fullness of the input buffer may have changed.  Reassess
    whether we should block receive interrupts.
    Called by the input buffer routines when characters are added
@@ -203,6 +323,22 @@ putc_poll (uint8_t byte)
   while ((inb (LSR_REG) & LSR_THRE) == 0)
     continue;
   outb (THR_REG, byte);
+  tx_cnt++;
+}
+
+/* Polls the serial port until it's ready, and then transmits as
+   many bytes from the transmit queue as it can take at once. */
+static void
+putq_poll (void) 
+{
+  int i;
+
+  putc_poll (intq_getc (&txq));
+  for (i = 1; i < tx_burst && !intq_empty (&txq); i++)
+    {
+      outb (THR_REG, intq_getc (&txq));
+      tx_cnt++;
+    }
 }
 
 /* Serial interrupt handler. */
@@ -218,10 +354,20 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
+  /* As long as we have bytes to transmit, and the hardware is
+     ready to accept them, fill the transmitter: up to a FIFO's
+     worth of bytes each time it drains. */
+  if (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
+    tx_intr_cnt++;
   while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+    {
+      int i;
+      for (i = 0; i < tx_burst && !intq_empty (&txq); i++)
+        {
+          outb (THR_REG, intq_getc (&txq));
+          tx_cnt++;
+        }
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
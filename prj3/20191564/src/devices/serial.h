@@ -1,11 +1,16 @@
 #ifndef DEVICES_SERIAL_H
 #define DEVICES_SERIAL_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 void serial_init_queue (void);
 void serial_putc (uint8_t);
+void serial_write (const uint8_t *, size_t);
 void serial_flush (void);
+bool serial_set_speed (int bps);
+void serial_print_stats (void);
 void serial_notify (void);
 
 #endif /* devices/serial.h */
@@ -9,8 +9,14 @@
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #endif
 
@@ -57,6 +63,7 @@ void
 shutdown_reboot (void)
 {
   printf ("Rebooting...\n");
+  console_flush ();
 
     /* See [kbd] for details on how to program the keyboard
      * controller. */
@@ -97,6 +104,7 @@ shutdown_power_off (void)
   print_stats ();
 
   printf ("Powering off...\n");
+  console_flush ();
   serial_flush ();
 
   /* ACPI power-off */
@@ -132,10 +140,17 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  cache_print_stats ();
 #endif
   console_print_stats ();
+  serial_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  page_print_stats ();
+  swap_print_stats ();
+  frame_print_stats ();
+#endif
 }
@@ -26,9 +26,11 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+static void write_run (const char *, size_t);
+static void advance (uint8_t c, size_t *x, size_t *y);
 static void clear_row (size_t y);
 static void cls (void);
-static void newline (void);
+static void scroll_up (size_t rows);
 static void move_cursor (void);
 static void find_cursor (size_t *x, size_t *y);
 
@@ -51,57 +53,134 @@ init (void)
 void
 vga_putc (int c)
 {
+  char ch = c;
+  vga_write (&ch, 1);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display,
+   interpreting control characters as vga_putc() does.  Each run
+   of characters between form feeds and bells scrolls the screen
+   at most once, and the hardware cursor is moved only at the
+   end.  BUFFER must be kernel memory: it is read with interrupts
+   off, where a page fault could not be serviced. */
+void
+vga_write (const char *buffer, size_t n)
+{
+  enum intr_level old_level;
+
+  ASSERT (n == 0 || is_kernel_vaddr (buffer));
+
   /* Disable interrupts to lock out interrupt handlers
      that might write to the console. */
-  enum intr_level old_level = intr_disable ();
+  old_level = intr_disable ();
 
   init ();
-  
+
+  while (n > 0)
+    {
+      size_t run = 0;
+      while (run < n && buffer[run] != '\f' && buffer[run] != '\a')
+        run++;
+
+      if (run > 0)
+        write_run (buffer, run);
+      else if (*buffer == '\f')
+        cls ();
+      else
+        {
+          intr_set_level (old_level);
+          speaker_beep ();
+          intr_disable ();
+        }
+
+      if (run == 0)
+        run = 1;
+      buffer += run;
+      n -= run;
+    }
+
+  /* Update cursor position. */
+  move_cursor ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes the N characters in BUFFER, none of which is a form
+   feed or a bell, at the cursor.  First works out where the
+   cursor ends up, then scrolls the screen once by however many
+   rows that is past the bottom, then stores the characters that
+   are still on screen. */
+static void
+write_run (const char *buffer, size_t n)
+{
+  size_t x, y, scroll;
+  size_t i;
+
+  x = cx;
+  y = cy;
+  for (i = 0; i < n; i++)
+    advance (buffer[i], &x, &y);
+  scroll = y >= ROW_CNT ? y - (ROW_CNT - 1) : 0;
+  if (scroll > 0)
+    scroll_up (scroll);
+
+  x = cx;
+  y = cy;
+  for (i = 0; i < n; i++)
+    {
+      uint8_t c = buffer[i];
+      if (c != '\n' && c != '\b' && c != '\r' && c != '\t' && y >= scroll)
+        {
+          fb[y - scroll][x][0] = c;
+          fb[y - scroll][x][1] = GRAY_ON_BLACK;
+        }
+      advance (c, &x, &y);
+    }
+  cx = x;
+  cy = y - scroll;
+}
+
+/* Moves (*X,*Y) past character C, which is not a form feed or a
+   bell.  *Y is not limited to the screen: it counts rows past
+   the bottom that the screen will have to scroll by. */
+static void
+advance (uint8_t c, size_t *x, size_t *y)
+{
   switch (c) 
     {
     case '\n':
-      newline ();
-      break;
-
-    case '\f':
-      cls ();
+      *x = 0;
+      ++*y;
       break;
 
     case '\b':
-      if (cx > 0)
-        cx--;
+      if (*x > 0)
+        --*x;
       break;
       
     case '\r':
-      cx = 0;
+      *x = 0;
       break;
 
     case '\t':
-      cx = ROUND_UP (cx + 1, 8);
-      if (cx >= COL_CNT)
-        newline ();
+      *x = ROUND_UP (*x + 1, 8);
+      if (*x >= COL_CNT)
+        {
+          *x = 0;
+          ++*y;
+        }
       break;
 
-    case '\a':
-      intr_set_level (old_level);
-      speaker_beep ();
-      intr_disable ();
-      break;
-      
     default:
-      fb[cy][cx][0] = c;
-      fb[cy][cx][1] = GRAY_ON_BLACK;
-      if (++cx >= COL_CNT)
-        newline ();
+      if (++*x >= COL_CNT)
+        {
+          *x = 0;
+          ++*y;
+        }
       break;
     }
-
-  /* Update cursor position. */
-  move_cursor ();
-
-  intr_set_level (old_level);
 }
-
+
 /* Clears the screen and moves the cursor to the upper left. */
 static void
 cls (void)
@@ -128,20 +207,18 @@ clear_row (size_t y)
     }
 }
 
-/* Advances the cursor to the first column in the next line on
-   the screen.  If the cursor is already on the last line on the
-   screen, scrolls the screen upward one line. */
+/* Scrolls the screen upward ROWS lines, clearing the rows that
+   come into view at the bottom. */
 static void
-newline (void)
+scroll_up (size_t rows)
 {
-  cx = 0;
-  cy++;
-  if (cy >= ROW_CNT)
-    {
-      cy = ROW_CNT - 1;
-      memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
-      clear_row (ROW_CNT - 1);
-    }
+  size_t y;
+
+  if (rows > ROW_CNT)
+    rows = ROW_CNT;
+  memmove (&fb[0], &fb[rows], sizeof fb[0] * (ROW_CNT - rows));
+  for (y = ROW_CNT - rows; y < ROW_CNT; y++)
+    clear_row (y);
 }
 
 /* Moves the hardware cursor to (cx,cy). */
@@ -4,12 +4,16 @@
 #include <syscall.h>
 
 static void read_line (char line[], size_t);
-static bool backspace (char **pos, char line[]);
 
 int
 main (void)
 {
+  bool was_raw;
+
   printf ("Shell starting...\n");
+
+  /* Let the console edit and echo our command lines. */
+  was_raw = ttyraw (false);
   for (;;) 
     {
       char command[80];
@@ -40,65 +44,35 @@ main (void)
         }
     }
 
+  ttyraw (was_raw);
   printf ("Shell exiting.");
   return EXIT_SUCCESS;
 }
 
 /* Reads a line of input from the user into LINE, which has room
-   for SIZE bytes.  Handles backspace and Ctrl+U in the ways
-   expected by Unix users.  On return, LINE will always be
-   null-terminated and will not end in a new-line character. */
+   for SIZE bytes.  The console's line discipline takes care of
+   echo, backspace and Ctrl+U, and hands us the whole line at
+   once.  Ctrl+D on an empty line reads as "exit".  On return,
+   LINE will always be null-terminated and will not end in a
+   new-line character. */
 static void
 read_line (char line[], size_t size) 
 {
-  char *pos = line;
-  for (;;)
+  int n = read (STDIN_FILENO, line, size - 1);
+  if (n <= 0)
     {
-      char c;
-      read (STDIN_FILENO, &c, 1);
-
-      switch (c) 
-        {
-        case '\r':
-          *pos = '\0';
-          putchar ('\n');
-          return;
-
-        case '\b':
-          backspace (&pos, line);
-          break;
-
-        case ('U' - 'A') + 1:       /* Ctrl+U. */
-          while (backspace (&pos, line))
-            continue;
-          break;
-
-        default:
-          /* Add character to line. */
-          if (pos < line + size - 1) 
-            {
-              putchar (c);
-              *pos++ = c;
-            }
-          break;
-        }
+      strlcpy (line, "exit", size);
+      return;
     }
-}
 
-/* If *POS is past the beginning of LINE, backs up one character
-   position.  Returns true if successful, false if nothing was
-   done. */
-static bool
-backspace (char **pos, char line[]) 
-{
-  if (*pos > line)
+  if (line[n - 1] == '\n')
+    n--;
+  else if ((size_t) n == size - 1)
     {
-      /* Back up cursor, overwrite character, back up
-         again. */
-      printf ("\b \b");
-      (*pos)--;
-      return true;
+      /* Line too long: discard the rest of it. */
+      char c;
+      while (read (STDIN_FILENO, &c, 1) == 1 && c != '\n')
+        continue;
     }
-  else
-    return false;
+  line[n] = '\0';
 }
@@ -0,0 +1,335 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.
+   Every sector of the file system device that the file system
+   reads or writes passes through one of CACHE_SIZE entries.
+   Modified entries are written back when they are evicted, by
+   the write-behind thread every WRITE_BEHIND_INTERVAL ticks, and
+   by cache_flush().  Eviction uses the clock algorithm.
+
+   CACHE_LOCK protects which sector each entry holds, and the
+   ACCESSED and USERS members.  An entry's own LOCK protects its
+   DATA and DIRTY members and is held while the entry is read
+   from or written to disk, except that an entry being evicted
+   is written back under CACHE_LOCK, so that no one can read its
+   sector from disk before the new data gets there.  CACHE_LOCK
+   is never acquired while holding an entry's LOCK.
+
+   Callers copy data in and out of their own buffers with the
+   entry locked, so those buffers must not be user memory that
+   could page fault: loading the page could need the same
+   entry. */
+
+/* Sector number of an entry that holds no sector. */
+#define INVALID_SECTOR ((block_sector_t) -1)
+
+/* Ticks between passes of the write-behind thread. */
+#define WRITE_BEHIND_INTERVAL TIMER_FREQ
+
+/* Maximum number of outstanding read-ahead requests. */
+#define READ_AHEAD_MAX 16
+
+/* A cached sector. */
+struct cache_entry
+  {
+    block_sector_t sector;      /* Sector held, or INVALID_SECTOR. */
+    bool accessed;              /* Used since the clock hand passed? */
+    int users;                  /* Threads using the entry; while
+                                   nonzero, it can't be evicted. */
+    struct lock lock;           /* Protects DATA and DIRTY. */
+    bool dirty;                 /* DATA differs from the disk? */
+    uint8_t data[BLOCK_SECTOR_SIZE];
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+
+/* Signaled when an entry's USERS drops to 0. */
+static struct condition cache_idle;
+
+/* Clock hand: index of the next entry to consider for eviction. */
+static size_t hand;
+
+/* Read-ahead requests, a circular queue protected by CACHE_LOCK. */
+static block_sector_t read_ahead_queue[READ_AHEAD_MAX];
+static size_t read_ahead_head;  /* Index of oldest request. */
+static size_t read_ahead_cnt;   /* Number of requests queued. */
+static struct semaphore read_ahead_sema;
+
+/* Statistics, protected by CACHE_LOCK. */
+static long long hit_cnt;        /* Lookups that found the sector. */
+static long long miss_cnt;       /* Lookups that had to evict. */
+static long long prefetch_cnt;   /* Sectors read ahead. */
+static long long write_back_cnt; /* Dirty sectors written back. */
+
+static struct cache_entry *cache_get (block_sector_t, bool load);
+static void cache_put (struct cache_entry *);
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *evict (void);
+static thread_func write_behind_thread;
+static thread_func read_ahead_thread;
+
+/* Initializes the buffer cache and starts its threads. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&cache_idle);
+  sema_init (&read_ahead_sema, 0);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      e->sector = INVALID_SECTOR;
+      e->accessed = false;
+      e->users = 0;
+      lock_init (&e->lock);
+      e->dirty = false;
+    }
+
+  thread_create ("write-behind", PRI_DEFAULT, write_behind_thread, NULL);
+  thread_create ("read-ahead", PRI_DEFAULT, read_ahead_thread, NULL);
+}
+
+/* Copies SIZE bytes starting at offset OFS within SECTOR into
+   BUFFER, which must not be user memory. */
+void
+cache_read (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_put (e);
+}
+
+/* Copies SIZE bytes from BUFFER, which must not be user memory,
+   into SECTOR starting at offset OFS.  The sector reaches the
+   disk later. */
+void
+cache_write (block_sector_t sector, const void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  /* A write of the whole sector needn't read it first. */
+  e = cache_get (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  cache_put (e);
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache
+   without waiting for it.  The request is dropped if SECTOR is
+   already cached or too many requests are outstanding. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  if (read_ahead_cnt < READ_AHEAD_MAX && lookup (sector) == NULL)
+    {
+      size_t tail = (read_ahead_head + read_ahead_cnt) % READ_AHEAD_MAX;
+      read_ahead_queue[tail] = sector;
+      read_ahead_cnt++;
+      sema_up (&read_ahead_sema);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty entry back to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      bool written = false;
+
+      /* Pin the entry, so it can't be evicted, and then lock it
+         to look at DIRTY. */
+      lock_acquire (&cache_lock);
+      if (e->sector == INVALID_SECTOR)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->users++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      if (e->dirty)
+        {
+          block_write (fs_device, e->sector, e->data);
+          e->dirty = false;
+          written = true;
+        }
+      cache_put (e);
+
+      /* CACHE_LOCK can't be taken while holding E's lock. */
+      if (written)
+        {
+          lock_acquire (&cache_lock);
+          write_back_cnt++;
+          lock_release (&cache_lock);
+        }
+    }
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld read ahead, "
+          "%lld written back\n",
+          hit_cnt, miss_cnt, prefetch_cnt, write_back_cnt);
+}
+
+/* Returns the entry for SECTOR, locked, evicting another sector
+   to make room if necessary.  If LOAD is true, the entry's data
+   is read from disk if it was not already cached; otherwise
+   the caller must overwrite all of it.  The caller must release
+   it with cache_put(). */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool load)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = lookup (sector);
+  if (e != NULL)
+    {
+      /* Another thread may still be loading it: wait for the
+         entry lock, not CACHE_LOCK. */
+      hit_cnt++;
+      e->users++;
+      e->accessed = true;
+      lock_release (&cache_lock);
+      lock_acquire (&e->lock);
+      return e;
+    }
+
+  miss_cnt++;
+  e = evict ();
+
+  /* Nobody else holds the lock of an entry with no users. */
+  lock_acquire (&e->lock);
+  if (e->sector != INVALID_SECTOR && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      write_back_cnt++;
+    }
+  e->sector = sector;
+  e->accessed = true;
+  e->users = 1;
+  e->dirty = false;
+  lock_release (&cache_lock);
+
+  /* Threads that look up SECTOR meanwhile find E and wait for
+     its lock. */
+  if (load)
+    block_read (fs_device, sector, e->data);
+  return e;
+}
+
+/* Unlocks E, which was returned by cache_get(). */
+static void
+cache_put (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  ASSERT (e->users > 0);
+  if (--e->users == 0)
+    cond_signal (&cache_idle, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry holding SECTOR, or a null pointer if SECTOR
+   is not cached.  The caller must hold CACHE_LOCK. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Chooses an entry to reuse with the clock algorithm, waiting
+   if every entry is in use.  The caller must hold CACHE_LOCK. */
+static struct cache_entry *
+evict (void)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;)
+    {
+      size_t i;
+
+      /* Two passes: the first may only clear ACCESSED bits. */
+      for (i = 0; i < 2 * CACHE_SIZE; i++)
+        {
+          struct cache_entry *e = &cache[hand];
+          hand = (hand + 1) % CACHE_SIZE;
+
+          if (e->users > 0)
+            continue;
+          if (e->sector == INVALID_SECTOR || !e->accessed)
+            return e;
+          e->accessed = false;
+        }
+      cond_wait (&cache_idle, &cache_lock);
+    }
+}
+
+/* Write-behind thread: periodically writes dirty entries back,
+   so that little is lost in a crash and evictions seldom have
+   to write. */
+static void
+write_behind_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (WRITE_BEHIND_INTERVAL);
+      cache_flush ();
+    }
+}
+
+/* Read-ahead thread: brings requested sectors into the cache. */
+static void
+read_ahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      sema_down (&read_ahead_sema);
+      lock_acquire (&cache_lock);
+      sector = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_MAX;
+      read_ahead_cnt--;
+      lock_release (&cache_lock);
+
+      cache_put (cache_get (sector, true));
+
+      lock_acquire (&cache_lock);
+      prefetch_cnt++;
+      lock_release (&cache_lock);
+    }
+}
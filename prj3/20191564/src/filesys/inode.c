@@ -2,32 +2,43 @@
 #include <list.h>
 #include <debug.h>
 #include <round.h>
+#include <stddef.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of sector numbers in the on-disk inode, and in an
+   index sector. */
+#define DIRECT_CNT 124
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   The file's data sectors are found through an index: the first
+   DIRECT_CNT sectors are listed in DIRECT, the next
+   PTRS_PER_SECTOR in the index sector INDIRECT, and the next
+   PTRS_PER_SECTOR squared through the index sectors listed in the
+   index sector DOUBLY_INDIRECT.  Sector number 0 (the free map's
+   inode, never a data sector) marks a hole: a data or index
+   sector that hasn't been allocated yet, which reads as zeros. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    block_sector_t direct[DIRECT_CNT];  /* Data sectors. */
+    block_sector_t indirect;            /* Index of data sectors. */
+    block_sector_t doubly_indirect;     /* Index of index sectors. */
   };
 
-/* Returns the number of sectors to allocate for an inode SIZE
-   bytes long. */
-static inline size_t
-bytes_to_sectors (off_t size)
-{
-  return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
-}
-
 /* In-memory inode. */
 struct inode 
   {
@@ -36,21 +47,152 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct lock lock;                   /* Held to allocate sectors or
+                                           extend the file. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Allocates a sector, zeroed, and returns it, or 0 if the disk
+   is full. */
+static block_sector_t
+allocate_sector (void) 
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  block_sector_t sector;
+
+  if (!free_map_allocate (1, &sector))
+    return 0;
+  cache_write (sector, zeros, 0, BLOCK_SECTOR_SIZE);
+  return sector;
+}
+
+/* Returns entry IDX of index sector INDEX.  If it is a hole and
+   ALLOCATE is true, allocates a sector for it first. */
+static block_sector_t
+get_index_entry (block_sector_t index, size_t idx, bool allocate) 
+{
+  block_sector_t sector;
+
+  cache_read (index, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == 0 && allocate)
+    {
+      sector = allocate_sector ();
+      if (sector != 0)
+        cache_write (index, &sector, idx * sizeof sector, sizeof sector);
+    }
+  return sector;
+}
+
+/* Returns the sector number in *SLOT, a member of INODE's
+   on-disk inode.  If it is a hole and ALLOCATE is true, allocates
+   a sector for it first. */
+static block_sector_t
+get_inode_entry (struct inode *inode, block_sector_t *slot, bool allocate) 
+{
+  if (*slot == 0 && allocate)
+    {
+      block_sector_t sector = allocate_sector ();
+      if (sector != 0)
+        {
+          *slot = sector;
+          cache_write (inode->sector, slot,
+                       (uint8_t *) slot - (uint8_t *) &inode->data,
+                       sizeof *slot);
+        }
+    }
+  return *slot;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   Returns 0 if INODE does not contain data for a byte at offset
+   POS: POS is past end of file, or in a hole.  If ALLOCATE is
+   true, POS may be past end of file, and holes on the way to POS
+   are allocated, so 0 means the disk is full or POS is beyond
+   the largest possible file.  The caller must then hold INODE's
+   lock. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos, bool allocate) 
 {
+  struct inode_disk *d = &inode->data;
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  block_sector_t index;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+  ASSERT (pos >= 0);
+  ASSERT (!allocate || lock_held_by_current_thread (&inode->lock));
+  if (!allocate && pos >= d->length)
+    return 0;
+
+  if (idx < DIRECT_CNT)
+    return get_inode_entry (inode, &d->direct[idx], allocate);
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    {
+      index = get_inode_entry (inode, &d->indirect, allocate);
+      return index != 0 ? get_index_entry (index, idx, allocate) : 0;
+    }
+  idx -= PTRS_PER_SECTOR;
+
+  if (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+    {
+      index = get_inode_entry (inode, &d->doubly_indirect, allocate);
+      if (index != 0)
+        index = get_index_entry (index, idx / PTRS_PER_SECTOR, allocate);
+      return index != 0 ? get_index_entry (index, idx % PTRS_PER_SECTOR,
+                                           allocate) : 0;
+    }
+  return 0;
+}
+
+/* Extends INODE's length to LENGTH, if it is shorter. */
+static void
+extend (struct inode *inode, off_t length) 
+{
+  lock_acquire (&inode->lock);
+  if (length > inode->data.length)
+    {
+      inode->data.length = length;
+      cache_write (inode->sector, &inode->data.length,
+                   offsetof (struct inode_disk, length),
+                   sizeof inode->data.length);
+    }
+  lock_release (&inode->lock);
+}
+
+/* Releases SECTOR and, if LEVEL > 0, the sectors listed in it,
+   recursively: LEVEL is 0 for a data sector, 1 for an index of
+   data sectors, 2 for an index of those.  Does nothing for a
+   hole. */
+static void
+release_sector (block_sector_t sector, int level) 
+{
+  size_t i;
+
+  if (sector == 0)
+    return;
+  if (level > 0)
+    for (i = 0; i < PTRS_PER_SECTOR; i++)
+      {
+        block_sector_t entry;
+        cache_read (sector, &entry, i * sizeof entry, sizeof entry);
+        release_sector (entry, level - 1);
+      }
+  free_map_release (sector, 1);
+}
+
+/* Releases all of INODE's data and index sectors. */
+static void
+release_sectors (struct inode *inode) 
+{
+  struct inode_disk *d = &inode->data;
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    release_sector (d->direct[i], 0);
+  release_sector (d->indirect, 1);
+  release_sector (d->doubly_indirect, 2);
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -66,14 +208,17 @@ inode_init (void)
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The data sectors are allocated and zeroed now; the
+   file can grow later by writing past its end.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
 inode_create (block_sector_t sector, off_t length)
 {
   struct inode_disk *disk_inode = NULL;
-  bool success = false;
+  struct inode *inode;
+  bool success = true;
+  off_t ofs;
 
   ASSERT (length >= 0);
 
@@ -82,26 +227,34 @@ inode_create (block_sector_t sector, off_t length)
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
   disk_inode = calloc (1, sizeof *disk_inode);
-  if (disk_inode != NULL)
+  if (disk_inode == NULL)
+    return false;
+  disk_inode->length = 0;
+  disk_inode->magic = INODE_MAGIC;
+  cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+  free (disk_inode);
+
+  inode = inode_open (sector);
+  if (inode == NULL)
+    return false;
+
+  lock_acquire (&inode->lock);
+  for (ofs = 0; ofs < length; ofs += BLOCK_SECTOR_SIZE)
+    if (byte_to_sector (inode, ofs, true) == 0)
+      {
+        success = false;
+        break;
+      }
+  lock_release (&inode->lock);
+
+  if (success)
+    extend (inode, length);
+  else
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
-      disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
-      free (disk_inode);
+      /* The caller releases SECTOR itself. */
+      release_sectors (inode);
     }
+  inode_close (inode);
   return success;
 }
 
@@ -137,7 +290,8 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  lock_init (&inode->lock);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
   return inode;
 }
 
@@ -177,8 +331,7 @@ inode_close (struct inode *inode)
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          release_sectors (inode);
         }
 
       free (inode); 
@@ -194,20 +347,117 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Position within an array of buffers. */
+struct iov_cursor
+  {
+    const struct iovec *iov;    /* Current buffer. */
+    int cnt;                    /* Buffers left, including IOV. */
+    size_t ofs;                 /* Offset within IOV. */
+  };
+
+/* Returns the number of bytes in CUR's buffers from its current
+   position on. */
+static off_t
+iov_left (const struct iov_cursor *cur)
+{
+  off_t left = 0;
+  int i;
+
+  for (i = 0; i < cur->cnt; i++)
+    left += cur->iov[i].iov_len;
+  return left - cur->ofs;
+}
+
+/* Returns a pointer to CUR's current position if at least SIZE
+   bytes follow it within the same buffer, otherwise a null
+   pointer. */
+static uint8_t *
+iov_contiguous (const struct iov_cursor *cur, size_t size)
+{
+  if (cur->cnt == 0 || cur->iov->iov_len - cur->ofs < size)
+    return NULL;
+  return (uint8_t *) cur->iov->iov_base + cur->ofs;
+}
+
+/* Advances CUR by SIZE bytes, copying them from SRC into the
+   buffers if SRC is nonnull or from the buffers into DST if DST
+   is nonnull.  Buffers in user memory are accessed with
+   copy_to_user() and copy_from_user(), so a bad user pointer
+   makes this return false, with CUR advanced partway, instead of
+   killing the process.  Returns true if successful. */
+static bool
+iov_advance (struct iov_cursor *cur, const uint8_t *src, uint8_t *dst,
+             size_t size)
+{
+  while (size > 0)
+    {
+      size_t left, chunk;
+      uint8_t *p;
+
+      ASSERT (cur->cnt > 0);
+      left = cur->iov->iov_len - cur->ofs;
+      chunk = size < left ? size : left;
+      p = (uint8_t *) cur->iov->iov_base + cur->ofs;
+      if (src != NULL)
+        {
+          if (!is_user_vaddr (p))
+            memcpy (p, src, chunk);
+          else if (!copy_to_user (p, src, chunk))
+            return false;
+          src += chunk;
+        }
+      if (dst != NULL)
+        {
+          if (!is_user_vaddr (p))
+            memcpy (dst, p, chunk);
+          else if (!copy_from_user (dst, p, chunk))
+            return false;
+          dst += chunk;
+        }
+      size -= chunk;
+      cur->ofs += chunk;
+      if (cur->ofs == cur->iov->iov_len)
+        {
+          cur->iov++;
+          cur->cnt--;
+          cur->ofs = 0;
+        }
+    }
+  return true;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return inode_readv_at (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOVCNT buffers in IOV, in order,
+   starting at position OFFSET, in a single pass over the
+   sectors: a sector that spans several buffers is looked up
+   only once.  Returns the number of bytes actually read, which
+   may be less than the total size of the buffers if an error
+   occurs or end of file is reached. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                off_t offset) 
 {
-  uint8_t *buffer = buffer_;
+  struct iov_cursor cur = { iov, iovcnt, 0 };
+  off_t size = iov_left (&cur);
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, false);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -217,26 +467,37 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       /* Number of bytes to actually copy out of this sector. */
       int chunk_size = size < min_left ? size : min_left;
+      uint8_t *direct;
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      direct = iov_contiguous (&cur, chunk_size);
+      if (direct != NULL && is_kernel_vaddr (direct))
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          /* Copy straight from the cache into a kernel buffer. */
+          if (sector_idx != 0)
+            cache_read (sector_idx, direct, sector_ofs, chunk_size);
+          else
+            memset (direct, 0, chunk_size);
+          iov_advance (&cur, NULL, NULL, chunk_size);
         }
       else 
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
+          /* Copy through a bounce buffer.  User memory can page
+             fault, and loading the page may need the very cache
+             entry we would be holding. */
           if (bounce == NULL) 
             {
               bounce = malloc (BLOCK_SECTOR_SIZE);
               if (bounce == NULL)
                 break;
             }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          if (sector_idx != 0)
+            cache_read (sector_idx, bounce, sector_ofs, chunk_size);
+          else
+            memset (bounce, 0, chunk_size);
+          if (!iov_advance (&cur, bounce, NULL, chunk_size))
+            break;
         }
       
       /* Advance. */
@@ -246,19 +507,47 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
     }
   free (bounce);
 
+  /* Start reading the next sector in the background, in case the
+     caller keeps reading sequentially. */
+  if (bytes_read > 0)
+    {
+      off_t next = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+      block_sector_t next_idx = byte_to_sector (inode, next, false);
+      if (next_idx != 0)
+        cache_read_ahead (next_idx);
+    }
+
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Writing past end of file extends INODE, leaving a hole between
+   the old end and OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or an error occurs. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return inode_writev_at (inode, &iov, 1, offset);
+}
+
+/* Writes the IOVCNT buffers in IOV, in order, into INODE,
+   starting at OFFSET, in a single pass over the sectors: a
+   sector that spans several buffers is looked up only once.
+   Extends INODE like inode_write_at().  Returns the number of
+   bytes actually written, which may be less than the total size
+   of the buffers if the disk fills up or an error occurs. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                 off_t offset) 
+{
+  struct iov_cursor cur = { iov, iovcnt, 0 };
+  off_t size = iov_left (&cur);
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
 
@@ -268,43 +557,39 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Number of bytes to actually write into this sector. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      int chunk_size = size < sector_left ? size : sector_left;
+      uint8_t *direct;
 
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      lock_acquire (&inode->lock);
+      sector_idx = byte_to_sector (inode, offset, true);
+      lock_release (&inode->lock);
+      if (sector_idx == 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      direct = iov_contiguous (&cur, chunk_size);
+      if (direct != NULL && is_kernel_vaddr (direct))
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          /* Copy straight from a kernel buffer into the cache. */
+          cache_write (sector_idx, direct, sector_ofs, chunk_size);
+          iov_advance (&cur, NULL, NULL, chunk_size);
         }
       else 
         {
-          /* We need a bounce buffer. */
+          /* Copy through a bounce buffer, as in inode_readv_at(). */
           if (bounce == NULL) 
             {
               bounce = malloc (BLOCK_SECTOR_SIZE);
               if (bounce == NULL)
                 break;
             }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          if (!iov_advance (&cur, NULL, bounce, chunk_size))
+            break;
+          cache_write (sector_idx, bounce, sector_ofs, chunk_size);
         }
 
       /* Advance. */
@@ -314,9 +599,84 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     }
   free (bounce);
 
+  /* Readers may see the new length only once the data is there.
+     OFFSET is now the end of what was written. */
+  if (bytes_written > 0)
+    extend (inode, offset);
+
   return bytes_written;
 }
 
+/* Copies SIZE bytes from SRC, starting at SRC_OFS, into DST,
+   starting at DST_OFS, without passing through a caller's buffer.
+   Extends DST like inode_write_at().  Returns the number of bytes
+   actually copied, which may be less than SIZE if end of file is
+   reached in SRC, the disk fills up, or an error occurs.  The
+   two ranges must not overlap if SRC and DST are the same
+   inode. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs,
+               struct inode *src, off_t src_ofs, off_t size) 
+{
+  off_t bytes_copied = 0;
+  uint8_t *bounce;
+
+  if (dst->deny_write_cnt)
+    return 0;
+
+  /* Only one cache entry may be held at a time, so each chunk
+     goes through BOUNCE. */
+  bounce = malloc (BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    return 0;
+
+  while (size > 0) 
+    {
+      /* Sectors to copy between, starting byte offsets within them. */
+      block_sector_t src_idx = byte_to_sector (src, src_ofs, false);
+      block_sector_t dst_idx;
+      int src_sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      int dst_sector_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+
+      /* Bytes left in SRC or either sector, least of all. */
+      off_t src_left = inode_length (src) - src_ofs;
+      int min_left = BLOCK_SECTOR_SIZE - src_sector_ofs;
+      if (BLOCK_SECTOR_SIZE - dst_sector_ofs < min_left)
+        min_left = BLOCK_SECTOR_SIZE - dst_sector_ofs;
+      if (src_left < min_left)
+        min_left = src_left;
+
+      /* Number of bytes to actually copy in this step. */
+      int chunk_size = size < min_left ? size : min_left;
+      if (chunk_size <= 0)
+        break;
+
+      lock_acquire (&dst->lock);
+      dst_idx = byte_to_sector (dst, dst_ofs, true);
+      lock_release (&dst->lock);
+      if (dst_idx == 0)
+        break;
+
+      if (src_idx != 0)
+        cache_read (src_idx, bounce, src_sector_ofs, chunk_size);
+      else
+        memset (bounce, 0, chunk_size);
+      cache_write (dst_idx, bounce, dst_sector_ofs, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      src_ofs += chunk_size;
+      dst_ofs += chunk_size;
+      bytes_copied += chunk_size;
+    }
+  free (bounce);
+
+  if (bytes_copied > 0)
+    extend (dst, dst_ofs);
+
+  return bytes_copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -337,6 +697,13 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/* Returns true if writes to INODE are currently denied. */
+bool
+inode_write_denied (const struct inode *inode) 
+{
+  return inode->deny_write_cnt > 0;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
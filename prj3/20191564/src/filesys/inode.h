@@ -2,6 +2,7 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <uio.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
@@ -16,8 +17,15 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int iovcnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int iovcnt,
+                       off_t offset);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs,
+                     struct inode *src, off_t src_ofs, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
+bool inode_write_denied (const struct inode *);
 off_t inode_length (const struct inode *);
 
 #endif /* filesys/inode.h */
@@ -1,14 +1,24 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
+static void acquire_console (void);
+static void release_console (void);
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *, size_t);
+static void log_write (const char *, size_t);
+static size_t log_append (const char *, size_t, bool sent);
+static void log_drain (void);
+static thread_func log_thread;
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -59,14 +69,120 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* Kernel log.
+   Everything written to the console is appended to LOG_BUF, a
+   ring that also keeps the most recent output around for
+   console_dump_log().  LOG_HEAD counts the characters ever
+   appended and LOG_TAIL the ones sent on to the vga display and
+   serial port.  Both only grow; character number N is stored in
+   LOG_BUF[N % LOG_BUF_SIZE].
+
+   Ordinarily output is sent to the devices as soon as it is
+   appended, so LOG_TAIL == LOG_HEAD.  With -klog, output is
+   only appended, and a low-priority thread sends it on later.
+   A thread that prints then no longer waits for the 9600 bps
+   serial port, or holds the console lock while it does. */
+#define LOG_BUF_SIZE 16384              /* Must be a power of 2. */
+static char log_buf[LOG_BUF_SIZE];
+static uint32_t log_head;
+static uint32_t log_tail;
+
+/* Defer console output to the log thread?  Set by -klog. */
+bool console_async;
+
+/* True while output is being deferred: from console_start_log()
+   until a kernel panic. */
+static bool log_async;
+
+/* Held while sending log output to the devices.  This is not
+   the console lock, so printers can keep appending meanwhile. */
+static struct lock log_lock;
+
+/* Upped when there is log output for the log thread to send. */
+static struct semaphore log_sema;
+
+/* Deferred output statistics. */
+static int64_t log_dropped;     /* Characters dropped, log full. */
+static int64_t log_overflows;   /* Times a printer had to drain. */
+
 /* Enable console locking. */
 void
 console_init (void) 
 {
   lock_init (&console_lock);
+  lock_init (&log_lock);
+  sema_init (&log_sema, 0);
   use_console_lock = true;
 }
 
+/* Starts deferring console output to the log thread, if -klog
+   was given.  Must be called after the thread system and serial
+   interrupts are running. */
+void
+console_start_log (void) 
+{
+  if (!console_async)
+    return;
+  thread_create ("klogd", PRI_MIN, log_thread, NULL);
+  log_async = true;
+}
+
+/* Sends all deferred console output to the devices before
+   returning. */
+void
+console_flush (void) 
+{
+  if (!log_async)
+    return;
+  if (intr_context ())
+    log_drain ();
+  else
+    {
+      lock_acquire (&log_lock);
+      log_drain ();
+      lock_release (&log_lock);
+    }
+}
+
+/* Prints the output still held in the kernel log, up to its
+   last LOG_BUF_SIZE characters, straight to the devices. */
+void
+console_dump_log (void) 
+{
+  char chunk[128];
+  uint32_t pos, end;
+
+  acquire_console ();
+  lock_acquire (&log_lock);
+  log_drain ();
+
+  end = log_head;
+  pos = end > LOG_BUF_SIZE ? end - LOG_BUF_SIZE : 0;
+  while (pos < end)
+    {
+      enum intr_level old_level;
+      size_t n, i;
+
+      /* Interrupt handlers may still be appending, overwriting
+         the oldest characters, so copy them out a piece at a
+         time with interrupts off. */
+      old_level = intr_disable ();
+      if (log_head - pos > LOG_BUF_SIZE)
+        pos = log_head - LOG_BUF_SIZE;
+      n = end - pos < sizeof chunk ? end - pos : sizeof chunk;
+      for (i = 0; i < n; i++)
+        chunk[i] = log_buf[(pos + i) % LOG_BUF_SIZE];
+      intr_set_level (old_level);
+
+      serial_write ((const uint8_t *) chunk, n);
+      vga_write (chunk, n);
+      pos += n;
+    }
+
+  lock_release (&log_lock);
+  release_console ();
+}
+
 /* Notifies the console that a kernel panic is underway,
    which warns it to avoid trying to take the console lock from
    now on. */
@@ -74,6 +190,14 @@ void
 console_panic (void) 
 {
   use_console_lock = false;
+
+  /* Get out whatever was deferred before the panic message,
+     then write synchronously from now on. */
+  if (log_async)
+    {
+      log_async = false;
+      log_drain ();
+    }
 }
 
 /* Prints console statistics. */
@@ -81,6 +205,9 @@ void
 console_print_stats (void) 
 {
   printf ("Console: %lld characters output\n", write_cnt);
+  if (console_async)
+    printf ("Console: %lld characters dropped, log full %lld times\n",
+            log_dropped, log_overflows);
 }
 
 /* Acquires the console lock. */
@@ -119,19 +246,31 @@ console_locked_by_current_thread (void)
           || lock_held_by_current_thread (&console_lock));
 }
 
+/* Auxiliary data for vprintf_helper(). */
+struct vprintf_aux 
+  {
+    char buf[64];       /* Character buffer. */
+    size_t len;         /* Number of characters in BUF. */
+    int char_cnt;       /* Total characters written so far. */
+  };
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
    Writes its output to both vga display and serial port. */
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux;
+  aux.len = 0;
+  aux.char_cnt = 0;
 
   acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
+  __vprintf (format, args, vprintf_helper, &aux);
+  if (aux.len > 0)
+    putbuf_have_lock (aux.buf, aux.len);
   release_console ();
 
-  return char_cnt;
+  return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -140,21 +279,23 @@ int
 puts (const char *s) 
 {
   acquire_console ();
-  while (*s != '\0')
-    putchar_have_lock (*s++);
+  putbuf_have_lock (s, strlen (s));
   putchar_have_lock ('\n');
   release_console ();
 
   return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console.  BUFFER
+   must be kernel memory, since it is copied into the log and
+   sent to the devices with interrupts off; copy user data in
+   first. */
 void
 putbuf (const char *buffer, size_t n) 
 {
+  ASSERT (n == 0 || is_kernel_vaddr (buffer));
   acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
+  putbuf_have_lock (buffer, n);
   release_console ();
 }
 
@@ -169,13 +310,19 @@ putchar (int c)
   return c;
 }
 
-/* Helper function for vprintf(). */
+/* Helper function for vprintf().  Collects characters in AUX
+   and writes them out a bufferful at a time. */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (char c, void *aux_) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  struct vprintf_aux *aux = aux_;
+  aux->buf[aux->len++] = c;
+  if (aux->len >= sizeof aux->buf)
+    {
+      putbuf_have_lock (aux->buf, aux->len);
+      aux->len = 0;
+    }
+  aux->char_cnt++;
 }
 
 /* Writes C to the vga display and serial port.
@@ -183,9 +330,116 @@ vprintf_helper (char c, void *char_cnt_)
    appropriate. */
 static void
 putchar_have_lock (uint8_t c) 
+{
+  char ch = c;
+  putbuf_have_lock (&ch, 1);
+}
+
+/* Writes the N characters in BUFFER to the vga display and
+   serial port, handing each device the whole run at once.
+   The caller has already acquired the console lock if
+   appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) 
 {
   ASSERT (console_locked_by_current_thread ());
-  write_cnt++;
-  serial_putc (c);
-  vga_putc (c);
+  write_cnt += n;
+  log_write (buffer, n);
+}
+
+/* Appends the N characters in BUFFER to the kernel log and, unless
+   output is being deferred, sends them to the devices.  If the
+   log fills up with deferred output, drains it ourselves, or
+   drops what doesn't fit if we can't sleep. */
+static void
+log_write (const char *buffer, size_t n) 
+{
+  if (!log_async)
+    {
+      log_append (buffer, n, true);
+      serial_write ((const uint8_t *) buffer, n);
+      vga_write (buffer, n);
+      return;
+    }
+
+  while (n > 0)
+    {
+      size_t appended = log_append (buffer, n, false);
+      buffer += appended;
+      n -= appended;
+      if (n == 0)
+        break;
+
+      if (intr_context () || intr_get_level () == INTR_OFF)
+        {
+          log_dropped += n;
+          break;
+        }
+      log_overflows++;
+      lock_acquire (&log_lock);
+      log_drain ();
+      lock_release (&log_lock);
+    }
+  sema_up (&log_sema);
+}
+
+/* Appends up to N characters from BUFFER to the log and returns
+   the number appended.  If SENT is true, they have been or are
+   about to be sent to the devices, so they may overwrite any
+   old characters.  Otherwise only as many are appended as fit
+   without overwriting output that has not yet been sent.
+   BUFFER must be kernel memory, since it is read with interrupts
+   off. */
+static size_t
+log_append (const char *buffer, size_t n, bool sent) 
+{
+  enum intr_level old_level = intr_disable ();
+  size_t i;
+
+  if (!sent)
+    {
+      size_t room = LOG_BUF_SIZE - (log_head - log_tail);
+      if (n > room)
+        n = room;
+    }
+  for (i = 0; i < n; i++)
+    log_buf[log_head++ % LOG_BUF_SIZE] = buffer[i];
+  if (sent)
+    log_tail = log_head;
+
+  intr_set_level (old_level);
+  return n;
+}
+
+/* Sends the log output that has not been sent yet to the vga
+   display and serial port.  The caller must hold LOG_LOCK, or be
+   in a context where no one else can be sending, such as during
+   a panic. */
+static void
+log_drain (void) 
+{
+  while (log_tail != log_head)
+    {
+      size_t ofs = log_tail % LOG_BUF_SIZE;
+      size_t n = log_head - log_tail;
+      if (n > LOG_BUF_SIZE - ofs)
+        n = LOG_BUF_SIZE - ofs;
+      serial_write ((const uint8_t *) log_buf + ofs, n);
+      vga_write (log_buf + ofs, n);
+      log_tail += n;
+    }
+}
+
+/* Log thread: sends deferred output to the devices whenever
+   there is some. */
+static void
+log_thread (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      sema_down (&log_sema);
+      lock_acquire (&log_lock);
+      log_drain ();
+      lock_release (&log_lock);
+    }
 }
@@ -1,7 +1,15 @@
 #ifndef __LIB_KERNEL_CONSOLE_H
 #define __LIB_KERNEL_CONSOLE_H
 
+#include <stdbool.h>
+
+/* Defer console output to a log thread?  Set by -klog. */
+extern bool console_async;
+
 void console_init (void);
+void console_start_log (void);
+void console_flush (void);
+void console_dump_log (void);
 void console_panic (void);
 void console_print_stats (void);
 
@@ -32,7 +32,22 @@ enum
 
 	/* Project 1 Additional System Call */
 	SYS_FIBONACCI,
-	SYS_MAX_OF_FOUR_INT
+	SYS_MAX_OF_FOUR_INT,
+
+	/* Project 3 Additional System Call */
+	SYS_VMSTAT,                 /* Report virtual memory statistics. */
+
+	/* Vectored I/O */
+	SYS_READV,                  /* Read from a file into several buffers. */
+	SYS_WRITEV,                 /* Write several buffers to a file. */
+
+	/* Positional I/O */
+	SYS_PREAD,                  /* Read from a file at an offset. */
+	SYS_PWRITE,                 /* Write to a file at an offset. */
+	SYS_COPY_FILE_RANGE,        /* Copy between two files in the kernel. */
+
+	/* Console input */
+	SYS_TTYRAW                  /* Switch stdin between raw and cooked. */
   };
 
 #endif /* lib/syscall-nr.h */
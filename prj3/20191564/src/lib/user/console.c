@@ -25,13 +25,38 @@ hprintf (int handle, const char *format, ...)
   return retval;
 }
 
+/* An output buffer for a file handle. */
+struct outbuf 
+  {
+    char *buf;          /* Character buffer. */
+    size_t size;        /* Capacity of BUF. */
+    size_t len;         /* Number of characters in BUF. */
+    int char_cnt;       /* Total characters added so far. */
+    int handle;         /* Output file handle. */
+    int mode;           /* _IONBF, _IOLBF, or _IOFBF. */
+    bool newline;       /* New-line added since the last flush? */
+  };
+
+/* Standard output.  The console is a terminal, so it starts out
+   line buffered, as C's stdout does. */
+static char stdout_chars[BUFSIZ];
+static struct outbuf stdout_buf =
+  {stdout_chars, sizeof stdout_chars, 0, 0, STDOUT_FILENO, _IOLBF, false};
+
+static struct outbuf *handle_to_outbuf (int handle);
+static void add_char (char, void *);
+static void end_output (struct outbuf *);
+static void flush (struct outbuf *);
+
 /* Writes string S to the console, followed by a new-line
    character. */
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
-  putchar ('\n');
+  while (*s != '\0')
+    add_char (*s++, &stdout_buf);
+  add_char ('\n', &stdout_buf);
+  end_output (&stdout_buf);
 
   return 0;
 }
@@ -40,55 +65,105 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  add_char (c, &stdout_buf);
+  end_output (&stdout_buf);
   return c;
 }
-
-/* Auxiliary data for vhprintf_helper(). */
-struct vhprintf_aux 
-  {
-    char buf[64];       /* Character buffer. */
-    char *p;            /* Current position in buffer. */
-    int char_cnt;       /* Total characters written so far. */
-    int handle;         /* Output file handle. */
-  };
 
-static void add_char (char, void *);
-static void flush (struct vhprintf_aux *);
+/* Sets the buffering MODE of HANDLE, after writing out anything
+   already buffered.  Only the standard output can be buffered.
+   Returns 0 if successful, -1 otherwise. */
+int
+hsetvbuf (int handle, int mode) 
+{
+  struct outbuf *b = handle_to_outbuf (handle);
+  if (b == NULL || (mode != _IONBF && mode != _IOLBF && mode != _IOFBF))
+    return -1;
+  flush (b);
+  b->mode = mode;
+  return 0;
+}
+
+/* Writes out any output buffered for HANDLE.
+   Returns 0 if successful, -1 if HANDLE is not buffered. */
+int
+hflush (int handle) 
+{
+  struct outbuf *b = handle_to_outbuf (handle);
+  if (b == NULL)
+    return -1;
+  flush (b);
+  return 0;
+}
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
-   HANDLE. */
+   HANDLE.  Output to the standard output goes through its
+   buffer; output to any other handle is written out before
+   returning. */
 int
 vhprintf (int handle, const char *format, va_list args) 
 {
-  struct vhprintf_aux aux;
-  aux.p = aux.buf;
-  aux.char_cnt = 0;
-  aux.handle = handle;
-  __vprintf (format, args, add_char, &aux);
-  flush (&aux);
-  return aux.char_cnt;
+  struct outbuf *b = handle_to_outbuf (handle);
+  char chars[64];
+  struct outbuf local;
+  int start_cnt;
+
+  if (b == NULL) 
+    {
+      local.buf = chars;
+      local.size = sizeof chars;
+      local.len = 0;
+      local.char_cnt = 0;
+      local.handle = handle;
+      local.mode = _IONBF;
+      local.newline = false;
+      b = &local;
+    }
+
+  start_cnt = b->char_cnt;
+  __vprintf (format, args, add_char, b);
+  end_output (b);
+  return b->char_cnt - start_cnt;
+}
+
+/* Returns the output buffer for HANDLE, or a null pointer if
+   HANDLE is not buffered. */
+static struct outbuf *
+handle_to_outbuf (int handle) 
+{
+  return handle == STDOUT_FILENO ? &stdout_buf : NULL;
 }
 
 /* Adds C to the buffer in AUX, flushing it if the buffer fills
    up. */
 static void
-add_char (char c, void *aux_) 
+add_char (char c, void *aux) 
+{
+  struct outbuf *b = aux;
+  b->buf[b->len++] = c;
+  if (c == '\n')
+    b->newline = true;
+  if (b->len >= b->size)
+    flush (b);
+  b->char_cnt++;
+}
+
+/* Finishes one output call on B, writing the buffer out if B's
+   mode asks for it. */
+static void
+end_output (struct outbuf *b) 
 {
-  struct vhprintf_aux *aux = aux_;
-  *aux->p++ = c;
-  if (aux->p >= aux->buf + sizeof aux->buf)
-    flush (aux);
-  aux->char_cnt++;
+  if (b->mode == _IONBF || (b->mode == _IOLBF && b->newline))
+    flush (b);
 }
 
-/* Flushes the buffer in AUX. */
+/* Flushes the buffer in B. */
 static void
-flush (struct vhprintf_aux *aux)
+flush (struct outbuf *b)
 {
-  if (aux->p > aux->buf)
-    write (aux->handle, aux->buf, aux->p - aux->buf);
-  aux->p = aux->buf;
+  if (b->len > 0)
+    write (b->handle, b->buf, b->len);
+  b->len = 0;
+  b->newline = false;
 }
@@ -4,4 +4,15 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffering modes for hsetvbuf(). */
+#define _IONBF 0        /* Unbuffered: write out every call. */
+#define _IOLBF 1        /* Line buffered: write out at each new-line. */
+#define _IOFBF 2        /* Fully buffered: write out when full. */
+
+/* Size of the standard output buffer. */
+#define BUFSIZ 512
+
+int hsetvbuf (int, int mode);
+int hflush (int);
+
 #endif /* lib/user/stdio.h */
@@ -1,4 +1,5 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
 /* Invokes syscall NUMBER, passing no arguments, and returns the
@@ -80,6 +81,7 @@
 void
 halt (void) 
 {
+  hflush (STDOUT_FILENO);
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -87,6 +89,7 @@ halt (void)
 void
 exit (int status)
 {
+  hflush (STDOUT_FILENO);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -94,6 +97,8 @@ exit (int status)
 pid_t
 exec (const char *file)
 {
+  /* Keep our output ahead of the child's. */
+  hflush (STDOUT_FILENO);
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
@@ -130,6 +135,9 @@ filesize (int fd)
 int
 read (int fd, void *buffer, unsigned size)
 {
+  /* Show any prompt before waiting for input. */
+  if (fd == STDIN_FILENO)
+    hflush (STDOUT_FILENO);
   return syscall3 (SYS_READ, fd, buffer, size);
 }
 
@@ -209,3 +217,51 @@ int max_of_four_int(int a, int b, int c, int d){
   // syscall4 사용
   return syscall4( SYS_MAX_OF_FOUR_INT, a, b, c, d);
 }
+
+/* Project3 Additional System Call */
+bool
+vmstat (struct vmstat *stats)
+{
+  return syscall1 (SYS_VMSTAT, stats);
+}
+
+/* Vectored I/O */
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (fd == STDIN_FILENO)
+    hflush (STDOUT_FILENO);
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+/* Positional I/O */
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+/* Console input */
+bool
+ttyraw (bool raw)
+{
+  return syscall1 (SYS_TTYRAW, raw);
+}
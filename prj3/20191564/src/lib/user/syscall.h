@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <uio.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -38,6 +40,21 @@ void close (int fd);
 int fibonacci(int n);
 int max_of_four_int(int a, int b, int c, int d);
 
+/* Project3 Additional System Call */
+bool vmstat (struct vmstat *);
+
+/* Vectored I/O */
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+
+/* Positional I/O */
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+
+/* Console input */
+bool ttyraw (bool raw);
+
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
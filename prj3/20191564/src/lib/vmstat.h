@@ -0,0 +1,17 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics for one process, as returned by the
+   vmstat system call. */
+struct vmstat
+  {
+    unsigned minor_faults;      /* Faults served without I/O. */
+    unsigned major_faults;      /* Faults that read a file or swap. */
+    unsigned swap_ins;          /* Pages read back from swap. */
+    unsigned swap_outs;         /* Pages written to swap. */
+    unsigned resident;          /* Pages currently in frames. */
+    unsigned working_set;       /* Pages used in the last interval. */
+    unsigned peak_working_set;  /* Largest working_set so far. */
+  };
+
+#endif /* lib/vmstat.h */
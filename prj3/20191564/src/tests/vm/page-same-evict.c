@@ -0,0 +1,60 @@
+/* Fills 1 MB with identical pages for the merge thread to fold
+   into one shared frame, then encrypts and decrypts 2 MB of other
+   memory to force that frame out to swap and back.  Checks that
+   the identical pages survive, then writes a different value
+   into each of them and checks those. */
+
+#include <string.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SAME_SIZE (1024 * 1024)
+#define CHURN_SIZE (2 * 1024 * 1024)
+
+static char same[SAME_SIZE];
+static char churn[CHURN_SIZE];
+
+/* Fails unless every byte of page PAGE of SAME is VALUE. */
+static void
+check_page (size_t page, char value)
+{
+  size_t i;
+
+  for (i = page * PAGE_SIZE; i < (page + 1) * PAGE_SIZE; i++)
+    if (same[i] != value)
+      fail ("byte %zu != %#x", i, value & 0xff);
+}
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  size_t page;
+  int pass;
+
+  msg ("initialize");
+  memset (same, 0x5a, sizeof same);
+
+  /* Each pass reads the identical pages, so that the merge thread
+     sees stable checksums, and pushes them out to swap. */
+  msg ("evict identical pages");
+  for (pass = 0; pass < 2; pass++)
+    {
+      for (page = 0; page < SAME_SIZE / PAGE_SIZE; page++)
+        check_page (page, 0x5a);
+      arc4_init (&arc4, "foobar", 6);
+      arc4_crypt (&arc4, churn, CHURN_SIZE);
+    }
+
+  msg ("read pass");
+  for (page = 0; page < SAME_SIZE / PAGE_SIZE; page++)
+    check_page (page, 0x5a);
+
+  msg ("write pass");
+  for (page = 0; page < SAME_SIZE / PAGE_SIZE; page++)
+    memset (same + page * PAGE_SIZE, page, PAGE_SIZE);
+  for (page = 0; page < SAME_SIZE / PAGE_SIZE; page++)
+    check_page (page, page);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-same-evict) begin
+(page-same-evict) initialize
+(page-same-evict) evict identical pages
+(page-same-evict) read pass
+(page-same-evict) write pass
+(page-same-evict) end
+EOF
+pass;
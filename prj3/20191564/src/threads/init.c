@@ -37,6 +37,11 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -118,6 +123,7 @@ main (void)
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
+  console_start_log ();
   timer_calibrate ();
 
 #ifdef FILESYS
@@ -127,6 +133,13 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  page_init ();
+  frame_init ();
+  swap_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -256,6 +269,13 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-klog"))
+        console_async = true;
+      else if (!strcmp (name, "-baud"))
+        {
+          if (!serial_set_speed (atoi (value)))
+            PANIC ("unsupported serial speed `%s'", value);
+        }
 #ifndef USERPROG
 	  /* Project #3 */
 	  else if(!strcmp(name, "-aging"))
@@ -264,6 +284,18 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+      else if (!strcmp (name, "-ra"))
+        read_ahead_limit = atoi (value);
+      else if (!strcmp (name, "-zp"))
+        swap_pool_pages = atoi (value);
+      else if (!strcmp (name, "-vmstat"))
+        page_stats_on_exit = true;
+      else if (!strcmp (name, "-merge"))
+        merge_scan_rate = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -297,6 +329,13 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints what is left of the kernel log. */
+static void
+run_dmesg (char **argv UNUSED)
+{
+  console_dump_log ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -314,6 +353,7 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"dmesg", 1, run_dmesg},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -362,6 +402,7 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  dmesg              Print the kernel log kept so far.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -384,8 +425,17 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -klog              Print console output from a log thread.\n"
+          "  -baud=BPS          Run the serial port at BPS (up to 115200).\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
+          "  -ra=COUNT          Read up to COUNT pages per file page fault.\n"
+          "  -zp=COUNT          Keep up to COUNT pages of compressed swap.\n"
+          "  -vmstat            Print paging statistics at process exit.\n"
+          "  -merge=RATE        Merge identical pages, scanning RATE frames/s.\n"
 #endif
           );
   shutdown_power_off ();
@@ -649,7 +649,10 @@ init_thread (struct thread *t, const char *name, int priority)
   t->child_succeed_flag = true;
   t->load_succeed_flag = true;
   sema_init(&(t->exec_lock), 0);
-  for(int i=0; i<128; i++) t->fd_table[i] = NULL;
+  t->fds = NULL;
+#endif
+#ifdef VM
+  list_init(&(t->mmaps));
 #endif
 
   // interrupt 킴
@@ -3,7 +3,9 @@
 
 #include <debug.h>
 #include <list.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <vmstat.h>
 #include "threads/synch.h"
 /* States in a thread's life cycle. */
 
@@ -113,8 +115,22 @@ struct thread
 	bool child_succeed_flag;
 	bool load_succeed_flag;
 	struct semaphore exec_lock;
-	struct file* fd_table[128];
+	struct fdtable* fds; // 열린 file 들, 처음 open 할 때 할당 (userprog/fdtable.c)
 
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, for demand paging. */
+    void *user_esp;                     /* User esp at system call entry. */
+    void *read_ahead_next;              /* Page after last read-ahead. */
+    size_t read_ahead_window;           /* Pages in last read-ahead. */
+    struct vmstat vmstat;               /* Fault and working set counts. */
+    int64_t working_set_tick;           /* Time of last working set sample. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mmaps;                  /* Memory-mapped files. */
+    int next_mapid;                     /* Identifier for next mmap(). */
 #endif
 	
 	int nice;
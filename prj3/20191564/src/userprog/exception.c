@@ -6,6 +6,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -149,7 +153,30 @@ page_fault (struct intr_frame *f)
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
-  if(!user || is_kernel_vaddr(fault_addr) || fault_addr == NULL || not_present){
+#ifdef VM
+  /* Bring in the page if it belongs to the process, whether the
+     process touched it itself or the kernel did on its behalf
+     inside a system call.  Otherwise it may be a push just below
+     the stack; for a fault in the kernel, F->esp is the kernel
+     stack, so judge by the user esp saved at system call entry.
+     A write to a present page may be the first write to the
+     shared zero page. */
+  if (user)
+    page_sample_working_set ();
+  if ((not_present || write)
+      && (page_fault_in (fault_addr, write)
+          || (not_present
+              && page_grow_stack (fault_addr,
+                                  user ? f->esp
+                                  : thread_current ()->user_esp))))
+    return;
+#endif
+  /* A bad user pointer passed to copy_from_user() and friends:
+     make the copy fail instead of killing the process. */
+  if (!user && uaccess_fixup (f))
+    return;
+  // 쓰기 금지된 page 에 write 한 경우도 process 만 종료
+  if(!user || is_kernel_vaddr(fault_addr) || fault_addr == NULL || not_present || write){
 	//printf("fault_address : %x\n", (uint32_t*)fault_addr);
 	exit(-1);
   }
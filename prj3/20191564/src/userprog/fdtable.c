@@ -0,0 +1,176 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "userprog/syscall.h"
+
+/* A process's open files, indexed by file descriptor.
+
+   The table is allocated on the first open() and grows by
+   doubling, so a process that opens no files costs nothing and
+   one that opens many is not limited.  A bitmap of used
+   descriptors, scanned a word at a time from the lowest
+   possibly free one, finds the lowest free descriptor without
+   looking at the files themselves. */
+struct fdtable
+  {
+    struct file **files;        /* Open file for each descriptor. */
+    uint32_t *used;             /* Bit set for each used descriptor. */
+    int size;                   /* Number of descriptors in FILES. */
+    int min_free;               /* No descriptor below this is free. */
+  };
+
+/* Descriptors in a newly allocated table. */
+#define FD_INITIAL 32
+
+/* Bits per word of the used bitmap. */
+#define FD_WORD_BITS 32
+
+static bool fd_grow (struct fdtable *);
+
+/* Returns the running process's descriptor table, allocating it
+   if necessary.  Returns a null pointer if memory is short. */
+static struct fdtable *
+fd_table (void)
+{
+  struct thread *t = thread_current ();
+  struct fdtable *fdt = t->fds;
+
+  if (fdt == NULL)
+    {
+      fdt = calloc (1, sizeof *fdt);
+      if (fdt == NULL)
+        return NULL;
+      fdt->min_free = FD_MIN;
+      if (!fd_grow (fdt))
+        {
+          free (fdt);
+          return NULL;
+        }
+      t->fds = fdt;
+    }
+  return fdt;
+}
+
+/* Doubles the size of FDT, or gives it FD_INITIAL descriptors if
+   it has none.  Returns true if successful, false if memory is
+   short, in which case FDT is unchanged. */
+static bool
+fd_grow (struct fdtable *fdt)
+{
+  int new_size = fdt->size > 0 ? fdt->size * 2 : FD_INITIAL;
+  struct file **files;
+  uint32_t *used;
+
+  files = realloc (fdt->files, new_size * sizeof *files);
+  if (files == NULL)
+    return false;
+  fdt->files = files;
+  used = realloc (fdt->used, new_size / FD_WORD_BITS * sizeof *used);
+  if (used == NULL)
+    return false;
+  fdt->used = used;
+
+  memset (files + fdt->size, 0, (new_size - fdt->size) * sizeof *files);
+  memset (used + fdt->size / FD_WORD_BITS, 0,
+          (new_size - fdt->size) / FD_WORD_BITS * sizeof *used);
+  if (fdt->size == 0)
+    used[0] = (1u << FD_MIN) - 1;
+  fdt->size = new_size;
+  return true;
+}
+
+/* Gives FILE the lowest free descriptor of the running process
+   and returns it, or -1 if memory is short. */
+int
+fd_install (struct file *file)
+{
+  struct fdtable *fdt = fd_table ();
+  int word, fd;
+
+  if (fdt == NULL)
+    return -1;
+
+  /* Every descriptor below min_free is in use, so start at its
+     word and skip full words. */
+  for (word = fdt->min_free / FD_WORD_BITS; ; word++)
+    {
+      if (word * FD_WORD_BITS >= fdt->size && !fd_grow (fdt))
+        return -1;
+      if (fdt->used[word] != UINT32_MAX)
+        break;
+    }
+  fd = word * FD_WORD_BITS + __builtin_ctz (~fdt->used[word]);
+
+  fdt->used[word] |= 1u << (fd % FD_WORD_BITS);
+  fdt->files[fd] = file;
+  fdt->min_free = fd + 1;
+  return fd;
+}
+
+/* Returns the running process's open file for descriptor FD, or
+   a null pointer if FD is not open. */
+struct file *
+fd_lookup (int fd)
+{
+  struct fdtable *fdt = thread_current ()->fds;
+
+  if (fdt == NULL || fd < FD_MIN || fd >= fdt->size)
+    return NULL;
+  return fdt->files[fd];
+}
+
+/* Frees descriptor FD of the running process and returns the
+   file it referred to, which the caller must close, or a null
+   pointer if FD is not open. */
+struct file *
+fd_remove (int fd)
+{
+  struct fdtable *fdt = thread_current ()->fds;
+  struct file *file = fd_lookup (fd);
+
+  if (file == NULL)
+    return NULL;
+  fdt->files[fd] = NULL;
+  fdt->used[fd / FD_WORD_BITS] &= ~(1u << (fd % FD_WORD_BITS));
+  if (fd < fdt->min_free)
+    fdt->min_free = fd;
+  return file;
+}
+
+/* Closes every file the running process has open and frees its
+   descriptor table.  Only the words of the bitmap are scanned,
+   not every descriptor. */
+void
+fd_close_all (void)
+{
+  struct thread *t = thread_current ();
+  struct fdtable *fdt = t->fds;
+  int word;
+
+  if (fdt == NULL)
+    return;
+
+  lock_acquire (&lock_for_file);
+  for (word = 0; word < fdt->size / FD_WORD_BITS; word++)
+    {
+      uint32_t bits = fdt->used[word];
+      if (word == 0)
+        bits &= ~((1u << FD_MIN) - 1);
+      while (bits != 0)
+        {
+          int fd = word * FD_WORD_BITS + __builtin_ctz (bits);
+          file_close (fdt->files[fd]);
+          bits &= bits - 1;
+        }
+    }
+  lock_release (&lock_for_file);
+
+  free (fdt->files);
+  free (fdt->used);
+  free (fdt);
+  t->fds = NULL;
+}
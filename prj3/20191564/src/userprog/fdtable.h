@@ -0,0 +1,15 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+struct file;
+
+/* Lowest file descriptor handed out for files.  0 and 1 are the
+   console; 2 is kept free, as it always has been. */
+#define FD_MIN 3
+
+int fd_install (struct file *);
+struct file *fd_lookup (int fd);
+struct file *fd_remove (int fd);
+void fd_close_all (void);
+
+#endif /* userprog/fdtable.h */
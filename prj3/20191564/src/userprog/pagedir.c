@@ -6,8 +6,14 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Range operations that touch more pages than this flush the
+   whole TLB with a single CR3 reload instead of issuing one
+   invlpg per page. */
+#define INVLPG_MAX 32
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -152,10 +158,52 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+   present" in page directory PD, like pagedir_clear_page(), but
+   invalidates the TLB once for the whole range: page by page for
+   short ranges, by reloading CR3 for long ones.
+   None of the pages need be mapped; stretches without a page
+   table are skipped a page table at a time, so the range may
+   cover the whole user address space. */
+void
+pagedir_clear_pages (uint32_t *pd, void *upage, size_t page_cnt)
+{
+  uint8_t *page = upage;
+  size_t cleared = 0;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (page_cnt <= (size_t) ((uint8_t *) PHYS_BASE - page) / PGSIZE);
+
+  while (page_cnt > 0)
+    {
+      uint32_t *pte = lookup_page (pd, page, false);
+      size_t step = 1;
+
+      if (pte == NULL)
+        {
+          /* No page table: skip to the next one. */
+          step = PGSIZE / sizeof *pte - pt_no (page);
+          if (step > page_cnt)
+            step = page_cnt;
+        }
+      else if ((*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          if (++cleared <= INVLPG_MAX)
+            invalidate_page (pd, page);
+        }
+      page += step * PGSIZE;
+      page_cnt -= step;
+    }
+  if (cleared > INVLPG_MAX)
+    invalidate_pagedir (pd);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -180,7 +228,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -209,18 +257,22 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register.  Does nothing if PD is already loaded, so that
+   switching back and forth between threads that share an
+   address space keeps the TLB warm. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = init_page_dir;
+  if (active_pd () == pd)
+    return;
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -256,8 +308,21 @@ invalidate_pagedir (uint32_t *pd)
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      /* Reloading CR3 clears the TLB.  See [IA32-v3a] 3.12
+         "Translation Lookaside Buffers (TLBs)".  We can't use
+         pagedir_activate() here, because it skips the reload
+         when PD is already active. */
+      asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
     } 
 }
+
+/* Invalidates the TLB entry for user virtual page VPAGE if PD is
+   the active page directory.  Unlike invalidate_pagedir(), this
+   leaves the translations for every other page in the TLB.  See
+   [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vpage) 
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+}
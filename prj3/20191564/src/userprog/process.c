@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/fdtable.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
@@ -17,6 +18,10 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 #define MAXARGV 256
 #define MAXLINE (1<<11)
@@ -214,6 +219,19 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  fd_close_all ();
+
+#ifdef VM
+  /* Write back mapped files and release the frames behind the
+     supplemental page table while the page directory that maps
+     them is still in place. */
+  mmap_unmap_all ();
+  page_table_destroy (cur->pages);
+  cur->pages = NULL;
+  file_close (cur->exec_file);
+  cur->exec_file = NULL;
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -243,8 +261,13 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel-only thread has no
+     user mappings of its own and the kernel mappings are the same
+     in every page directory, so it keeps running on whichever one
+     is loaded.  That way a process that is only interrupted by
+     kernel threads gets its TLB back intact. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -338,6 +361,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  t->pages = page_table_create ();
+  if (t->pages == NULL)
+    goto done;
+#endif
 
   char*argv[MAXARGV];
   char* commandline = (char*)malloc(sizeof(char) * strlen(file_name)+1);
@@ -439,12 +467,22 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* Segments are read in on demand, so the executable stays open,
+     and unwritable, until process_exit() closes it. */
+  if (file != NULL)
+    file_deny_write (file);
+  t->exec_file = file;
+#else
   file_close (file);
+#endif
   return success;
 }
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -503,6 +541,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, nothing is read here: each page is only recorded in
+   the supplemental page table and page_fault_in() reads it the
+   first time the process touches it.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -513,7 +555,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -522,6 +566,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      if (!page_add_file (upage, file, ofs, page_read_bytes,
+                          page_zero_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -541,6 +591,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -555,6 +606,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  bool success = page_add_zero (upage, true) && page_fault_in (upage, true);
+  if (success)
+    *esp = PHYS_BASE;
+  return success;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -569,6 +627,7 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -580,6 +639,7 @@ setup_stack (void **esp)
    with palloc_get_page().
    Returns true on success, false if UPAGE is already mapped or
    if memory allocation fails. */
+#ifndef VM
 static bool
 install_page (void *upage, void *kpage, bool writable)
 {
@@ -592,5 +652,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
-
-
+#endif
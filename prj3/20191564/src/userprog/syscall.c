@@ -4,153 +4,211 @@
 #include "devices/input.h"
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <uio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "lib/kernel/console.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "process.h"
+#include "uaccess.h"
+#include "fdtable.h"
 #include "threads/synch.h"
+#include "threads/palloc.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
 /* project1 system call 구현, file 관련된 건 read, write 만 */
 
-#define SYS_CALL_NUM 30 
-#define FILE_NAME 0
+#define SYS_ARG_MAX 4
 #define FILE_DESC 1
-#define FILE_BUFFER 2
+#define FILE_NAME_LEN 128
+#define INPUT_CHUNK 256   // stdin 에서 한 번에 받는 최대 byte 수 (한 줄)
+#define OUTPUT_CHUNK 256  // stdout 으로 한 번에 kernel 로 복사해서 내보내는 byte 수
 typedef int pid_t;
 struct lock lock_for_file;
-static int argNums[SYS_CALL_NUM];
-static void argNumInit(void); // system call 의 arg 개수 체크
-static bool checkUserMemoryAccess(uint32_t *offset); // user가 준 pointer값 맞는지 체크
+static bool copyInFileName(char* dst, const char* ufile); // user가 준 file 이름을 kernel 로 복사
+static bool putUserBuf(const void* ubuf, size_t size); // user buffer 를 console 로 출력
 
 /* Project1 System Call */
 void halt(void);
-pid_t exec(struct intr_frame* f);
-int wait(struct intr_frame* f);
-int read(struct intr_frame* f);
-int write(struct intr_frame* f);
+pid_t exec(const char* ucmd);
+int wait(pid_t pid);
+int read(int fd, void* buffer, unsigned size);
+int write(int fd, const void* buffer, unsigned size);
 /* Project1 Additional System Call */
-static int fibonacci(struct intr_frame* f);
-static int max_of_four_int(struct intr_frame *f);
+static int fibonacci(int n);
+static int max_of_four_int(int a, int b, int c, int d);
 
 /* Project2 System Call */
-bool create(struct intr_frame* f);
-bool remove(struct intr_frame* f);
-int open(struct intr_frame* f);
-int filesize(struct intr_frame* f);
-void seek(struct intr_frame* f);
-unsigned tell(struct intr_frame* f);
-void close(struct intr_frame* f);
+bool create(const char* ufile, unsigned initial_size);
+bool remove(const char* ufile);
+int open(const char* ufile);
+int filesize(int fd);
+void seek(int fd, unsigned position);
+unsigned tell(int fd);
+void close(int fd);
 static bool checkFileValidation(void* param, int flag);
 
-
-void argNumInit(void){
-  argNums[SYS_HALT] = 0;
-  argNums[SYS_EXEC] = argNums[SYS_WAIT] = argNums[SYS_EXIT] = argNums[SYS_FIBONACCI] = argNums[SYS_REMOVE] = argNums[SYS_OPEN] = 1;
-  argNums[SYS_FILESIZE] = argNums[SYS_TELL] = argNums[SYS_CLOSE] = 1;
-  argNums[SYS_CREATE] = argNums[SYS_SEEK] = 2;
-  argNums[SYS_READ] = argNums[SYS_WRITE] = 3;
-  argNums[SYS_MAX_OF_FOUR_INT] = 4;
-
-  lock_init(&lock_for_file);
-}
-
-bool checkUserMemoryAccess(uint32_t* offset){
-  return !is_user_vaddr((void*)offset) || pagedir_get_page(thread_current()->pagedir, (void*)offset) == NULL;
+#ifdef VM
+/* Project3 System Call */
+mapid_t mmap(int fd, void* addr);
+void munmap(mapid_t mapping);
+/* Project3 Additional System Call */
+static bool vmstat(struct vmstat* buffer);
+#endif
+
+/* Vectored I/O */
+int readv(int fd, const struct iovec* uiov, int iovcnt);
+int writev(int fd, const struct iovec* uiov, int iovcnt);
+static int copyInIovec(struct iovec* iov, const struct iovec* uiov, int iovcnt);
+
+/* Positional I/O */
+int pread(int fd, void* buffer, unsigned size, unsigned offset);
+int pwrite(int fd, const void* buffer, unsigned size, unsigned offset);
+int copy_file_range(int fd_in, int fd_out, unsigned size);
+
+/* Console input */
+static bool ttyraw(bool raw);
+
+/* System call table.
+   각 system call 의 handler 와 argument 개수. user stack 의 argument 는
+   handler 를 부르기 전에 한 번에 kernel 배열로 복사되고, SYSCALLn 이 만든
+   stub 이 그 배열의 word 를 handler 의 argument type 으로 바꿔서 넘겨줌 */
+typedef uint32_t syscall_stub(const uint32_t* args);
+struct syscall_desc{
+  syscall_stub* stub;   // NULL 이면 없는 system call
+  int argc;             // argument 개수, SYS_ARG_MAX 이하
+};
+
+#define SYSCALL0(NAME) \
+  static uint32_t NAME##_stub(const uint32_t* a UNUSED){ return (uint32_t)NAME(); }
+#define SYSCALL1(NAME, T1) \
+  static uint32_t NAME##_stub(const uint32_t* a){ return (uint32_t)NAME((T1)a[0]); }
+#define SYSCALL2(NAME, T1, T2) \
+  static uint32_t NAME##_stub(const uint32_t* a){ return (uint32_t)NAME((T1)a[0], (T2)a[1]); }
+#define SYSCALL3(NAME, T1, T2, T3) \
+  static uint32_t NAME##_stub(const uint32_t* a){ return (uint32_t)NAME((T1)a[0], (T2)a[1], (T3)a[2]); }
+#define SYSCALL4(NAME, T1, T2, T3, T4) \
+  static uint32_t NAME##_stub(const uint32_t* a){ return (uint32_t)NAME((T1)a[0], (T2)a[1], (T3)a[2], (T4)a[3]); }
+/* 돌려줄 값이 없는 handler 용 */
+#define SYSCALL0_VOID(NAME) \
+  static uint32_t NAME##_stub(const uint32_t* a UNUSED){ NAME(); return 0; }
+#define SYSCALL1_VOID(NAME, T1) \
+  static uint32_t NAME##_stub(const uint32_t* a){ NAME((T1)a[0]); return 0; }
+#define SYSCALL2_VOID(NAME, T1, T2) \
+  static uint32_t NAME##_stub(const uint32_t* a){ NAME((T1)a[0], (T2)a[1]); return 0; }
+
+SYSCALL0_VOID(halt)
+SYSCALL1_VOID(exit, int)
+SYSCALL1(exec, const char*)
+SYSCALL1(wait, pid_t)
+SYSCALL3(read, int, void*, unsigned)
+SYSCALL3(write, int, const void*, unsigned)
+SYSCALL1(fibonacci, int)
+SYSCALL4(max_of_four_int, int, int, int, int)
+SYSCALL2(create, const char*, unsigned)
+SYSCALL1(remove, const char*)
+SYSCALL1(open, const char*)
+SYSCALL1(filesize, int)
+SYSCALL2_VOID(seek, int, unsigned)
+SYSCALL1(tell, int)
+SYSCALL1_VOID(close, int)
+#ifdef VM
+SYSCALL2(mmap, int, void*)
+SYSCALL1_VOID(munmap, mapid_t)
+SYSCALL1(vmstat, struct vmstat*)
+#endif
+SYSCALL3(readv, int, const struct iovec*, int)
+SYSCALL3(writev, int, const struct iovec*, int)
+SYSCALL4(pread, int, void*, unsigned, unsigned)
+SYSCALL4(pwrite, int, const void*, unsigned, unsigned)
+SYSCALL3(copy_file_range, int, int, unsigned)
+SYSCALL1(ttyraw, bool)
+
+static const struct syscall_desc syscall_table[] = {
+  /* Project1 System Call */
+  [SYS_HALT] = {halt_stub, 0},
+  [SYS_EXIT] = {exit_stub, 1},
+  [SYS_EXEC] = {exec_stub, 1},
+  [SYS_WAIT] = {wait_stub, 1},
+  [SYS_READ] = {read_stub, 3},
+  [SYS_WRITE] = {write_stub, 3},
+  /* Project1 Additional System Call */
+  [SYS_FIBONACCI] = {fibonacci_stub, 1},
+  [SYS_MAX_OF_FOUR_INT] = {max_of_four_int_stub, 4},
+  /* Project2 System Call */
+  [SYS_CREATE] = {create_stub, 2},
+  [SYS_REMOVE] = {remove_stub, 1},
+  [SYS_OPEN] = {open_stub, 1},
+  [SYS_FILESIZE] = {filesize_stub, 1},
+  [SYS_SEEK] = {seek_stub, 2},
+  [SYS_TELL] = {tell_stub, 1},
+  [SYS_CLOSE] = {close_stub, 1},
+#ifdef VM
+  /* Project3 System Call */
+  [SYS_MMAP] = {mmap_stub, 2},
+  [SYS_MUNMAP] = {munmap_stub, 1},
+  /* Project3 Additional System Call */
+  [SYS_VMSTAT] = {vmstat_stub, 1},
+#endif
+  /* Vectored I/O */
+  [SYS_READV] = {readv_stub, 3},
+  [SYS_WRITEV] = {writev_stub, 3},
+  /* Positional I/O */
+  [SYS_PREAD] = {pread_stub, 4},
+  [SYS_PWRITE] = {pwrite_stub, 4},
+  [SYS_COPY_FILE_RANGE] = {copy_file_range_stub, 3},
+  /* Console input */
+  [SYS_TTYRAW] = {ttyraw_stub, 1},
+};
+
+#define SYS_CALL_NUM (sizeof syscall_table / sizeof *syscall_table)
+
+// 잘못된 pointer 면 process 종료, 이름이 너무 길면 false
+bool copyInFileName(char* dst, const char* ufile){
+  int len = strncpy_from_user(dst, ufile, FILE_NAME_LEN);
+  if(len < 0) exit(-1);
+  return len < FILE_NAME_LEN;
 }
 
 void
 syscall_init (void) 
 {
-  argNumInit();
+  lock_init(&lock_for_file);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
 /* project1, system call implementation */
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
- 
-  if(checkUserMemoryAccess((uint32_t*)(f->esp))) exit(-1);
+  uint32_t syscall_number;
+  uint32_t args[SYS_ARG_MAX];
+  const struct syscall_desc* desc;
+
+#ifdef VM
+  // kernel 안에서 user stack 에 page fault 가 나면 이 esp 로 stack growth 판단
+  thread_current()->user_esp = f->esp;
+  page_sample_working_set();
+#endif
 	
-  int syscall_number = (int)*((uint32_t*)(f->esp));
+  // user 메모리 참조 검토: pagedir 를 보지 않고 복사해 보고, 잘못된 주소면 page fault 에서 실패
+  if(!get_user(&syscall_number, f->esp)) exit(-1);
   //printf("syscall number : %d\n", syscall_number);
-  // user 메모리 참조 검토
-  for(int argnum=1; argnum <= argNums[syscall_number]; argnum++){
-    if(checkUserMemoryAccess((uint32_t*)(f->esp)+argnum)){
-      exit(-1);
-    }
-  }
-
-  
-  switch(syscall_number){
-    case SYS_HALT:
-      halt();
-      break;
-    
-    case SYS_EXIT:
-      exit(*((uint32_t*)(f->esp)+1));
-      break;
-
-    case SYS_EXEC:
-      f->eax = exec(f);
-      break;
-      
-    case SYS_WAIT:
-      f->eax = wait(f);
-      break;
-
-    case SYS_READ:
-      f->eax = read(f);
-      break;
-    
-    case SYS_WRITE:
-      f->eax = write(f); // intr frame 받아서, putbuf를 이용해 화면에 출력
-      break;
-
-	case SYS_FIBONACCI:
-	  f->eax = fibonacci(f);
-	  break;
-	
-	case SYS_MAX_OF_FOUR_INT:
-	  f->eax = max_of_four_int(f);
-	  break;
-
-	// project2 System Call
-	
-	case SYS_CREATE:
-	  f->eax = create(f);
-	  break;
-
-	case SYS_REMOVE:
-	  f->eax = remove(f);
-	  break;
+  if(syscall_number >= SYS_CALL_NUM || syscall_table[syscall_number].stub == NULL) exit(-1);
+  desc = &syscall_table[syscall_number];
 
-	case SYS_OPEN:
-	  f->eax = open(f);
-	  break;
-
-	case SYS_FILESIZE:
-	  f->eax = filesize(f);
-	  break;
-
-	case SYS_SEEK:
-	  seek(f);
-	  break;
-
-	case SYS_TELL:
-	  f->eax = tell(f);
-	  break;
-
-	case SYS_CLOSE:
-	  close(f);
-	  break;
-	}
+  // argument 전부를 한 번에 복사
+  if(!copy_from_user(args, (uint32_t*)(f->esp)+1, desc->argc*sizeof(uint32_t))) exit(-1);
+  f->eax = desc->stub(args);
 }
 
 void halt(void){  
@@ -160,44 +218,58 @@ void halt(void){
 
 void exit(int status){
   printf("%s: exit(%d)\n", thread_name(), status);
+#ifdef VM
+  page_print_process_stats();
+#endif
   thread_current()->exit_status = status;
-  for(int i=3; i<128; i++){
-	if(thread_current()->fd_table[i] == NULL) continue;
-	file_close(thread_current()->fd_table[i]);
-  }
+  /* A bad user pointer can kill us in the middle of a file system
+     call; don't take the lock to the grave. */
+  if(lock_held_by_current_thread(&lock_for_file)) lock_release(&lock_for_file);
+  // 열린 file 은 process_exit 에서 닫음
 
   thread_exit();
   return;
 } 
 
-pid_t exec(struct intr_frame* f){
-  return process_execute((void*)*((uint32_t *)(f->esp)+1));
+pid_t exec(const char* ucmd){
+  char* cmd = palloc_get_page(0);
+  pid_t pid = -1;
+
+  if(cmd == NULL) return -1;
+  // command line 을 kernel page 로 복사, 잘못된 pointer 면 종료
+  int len = strncpy_from_user(cmd, ucmd, PGSIZE);
+  if(len < 0){
+	palloc_free_page(cmd);
+	exit(-1);
+  }
+  if(len < PGSIZE) pid = process_execute(cmd);
+  palloc_free_page(cmd);
+  return pid;
 }
 
-int wait(struct intr_frame* f){
-  return process_wait(*((uint32_t *)(f->esp)+1));
+int wait(pid_t pid){
+  return process_wait(pid);
 }
 
-int write(struct intr_frame *f){;
-  int fd = (int)*((uint32_t *)(f->esp)+1);
-  void* buffer = (void *)*((uint32_t *)(f->esp)+2);
-  unsigned size = (int)*((uint32_t *)(f->esp)+3);
+int write(int fd, const void* buffer, unsigned size){
   //printf("write : %s\n", (char*)buffer);
 
-  if(!checkFileValidation((void*)buffer, FILE_BUFFER)) exit(-1);
+  // buffer 전체가 user 영역인지 확인
+  if(!is_user_range(buffer, size)) exit(-1);
 
   if(fd == STDOUT_FILENO){
 
 	lock_acquire(&lock_for_file);
-    putbuf(buffer, size);
+	bool ok = putUserBuf(buffer, size);
 	lock_release(&lock_for_file);
+	if(!ok) exit(-1);
     return size;
   }
 
   else{
 	if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
 	lock_acquire(&lock_for_file);
-	int res = file_write(thread_current()->fd_table[fd], buffer, size);
+	int res = file_write(fd_lookup(fd), buffer, size);
 	lock_release(&lock_for_file);
 	return res;
   }
@@ -206,34 +278,45 @@ int write(struct intr_frame *f){;
 }
 
 
-int read(struct intr_frame* f){
-  int fd = (int)*((uint32_t *)(f->esp)+1);
-  char* buffer = (char *)*((uint32_t *)(f->esp)+2);
-  unsigned size = (int)*((uint32_t *)(f->esp)+3);
+// user buffer 를 OUTPUT_CHUNK 씩 kernel 로 복사한 뒤 putbuf 로 출력.
+// console driver 는 interrupt 를 끄고 buffer 를 읽기 때문에 user memory 를
+// 직접 넘기면 안 됨 (page fault 시 swap/file I/O 를 기다릴 수 없음).
+// 중간에 잘못된 주소를 만나면 false, lock 은 caller 가 풀고 exit
+bool putUserBuf(const void* ubuf, size_t size){
+  const uint8_t* src = ubuf;
+  uint8_t chunk[OUTPUT_CHUNK];
+
+  while(size > 0){
+	size_t n = size < sizeof chunk ? size : sizeof chunk;
+	if(!copy_from_user(chunk, src, n)) return false;
+	putbuf((const char*)chunk, n);
+	src += n;
+	size -= n;
+  }
+  return true;
+}
+
+int read(int fd, void* buffer_, unsigned size){
+  char* buffer = buffer_;
   //hex_dump(f->esp, f->esp, 100, 1);
 
-  if(!checkFileValidation((void*)buffer, FILE_BUFFER)) exit(-1);
+  // buffer 전체가 user 영역인지 확인
+  if(!is_user_range(buffer, size)) exit(-1);
   
 
   if(fd == 0){
-	int cnt=0;
-	char c;
-		
-	lock_acquire(&lock_for_file);
-	while(cnt++ < size){
-	  c = input_getc();
-	  *buffer = c;
-	  buffer++;
-	  if(c == '\0') break;
-	}
-	lock_release(&lock_for_file);
+	// line discipline 에서 한 줄(raw mode 면 들어와 있는 key)을 받아서
+	// 한 번에 user 로 복사. file system 과 상관없으니 file lock 은 안 잡음
+	uint8_t chunk[INPUT_CHUNK];
+	size_t cnt = input_read(chunk, size < sizeof chunk ? size : sizeof chunk);
+	if(!copy_to_user(buffer, chunk, cnt)) exit(-1);
 	return cnt;
   }
 
   else{
 	if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
 	lock_acquire(&lock_for_file);
-	int res = file_read(thread_current()->fd_table[fd], buffer, size);
+	int res = file_read(fd_lookup(fd), buffer, size);
 	lock_release(&lock_for_file);
 	return res;
   }
@@ -241,8 +324,132 @@ int read(struct intr_frame* f){
   return -1;
 }
 
-int fibonacci(struct intr_frame* f){
-  int n = (int)*((uint32_t *)(f->esp) + 1);
+/* Vectored I/O */
+// iovec 배열을 한 번에 kernel 로 복사하고 각 buffer 가 user 영역인지 확인.
+// 전체 byte 수를 반환, iovcnt 가 잘못됐거나 합이 int 를 넘으면 -1
+int copyInIovec(struct iovec* iov, const struct iovec* uiov, int iovcnt){
+  int total = 0;
+
+  if(iovcnt < 0 || iovcnt > IOV_MAX) return -1;
+  if(!copy_from_user(iov, uiov, iovcnt*sizeof(struct iovec))) exit(-1);
+  for(int i=0; i<iovcnt; i++){
+	if(!is_user_range(iov[i].iov_base, iov[i].iov_len)) exit(-1);
+	if(iov[i].iov_len > (size_t)(INT_MAX - total)) return -1;
+	total += iov[i].iov_len;
+  }
+  return total;
+}
+
+int writev(int fd, const struct iovec* uiov, int iovcnt){
+  struct iovec iov[IOV_MAX];
+  int total = copyInIovec(iov, uiov, iovcnt);
+  if(total < 0) return -1;
+
+  // file lock 은 전체 전송에 한 번만 잡음
+  if(fd == STDOUT_FILENO){
+	bool ok = true;
+	lock_acquire(&lock_for_file);
+	for(int i=0; i<iovcnt && ok; i++) ok = putUserBuf(iov[i].iov_base, iov[i].iov_len);
+	lock_release(&lock_for_file);
+	if(!ok) exit(-1);
+	return total;
+  }
+
+  if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
+  lock_acquire(&lock_for_file);
+  int res = file_writev(fd_lookup(fd), iov, iovcnt);
+  lock_release(&lock_for_file);
+  return res;
+}
+
+int readv(int fd, const struct iovec* uiov, int iovcnt){
+  struct iovec iov[IOV_MAX];
+  int total = copyInIovec(iov, uiov, iovcnt);
+  if(total < 0) return -1;
+
+  if(fd == STDIN_FILENO){
+	// read 와 같이 line discipline 에서 한 번 받아서 segment 들에 나눠 복사
+	uint8_t chunk[INPUT_CHUNK];
+	size_t cnt = input_read(chunk, (size_t)total < sizeof chunk ? (size_t)total : sizeof chunk);
+	size_t done = 0;
+	for(int i=0; i<iovcnt && done < cnt; i++){
+	  size_t n = cnt - done < iov[i].iov_len ? cnt - done : iov[i].iov_len;
+	  if(!copy_to_user(iov[i].iov_base, chunk + done, n)) exit(-1);
+	  done += n;
+	}
+	return cnt;
+  }
+
+  if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
+  lock_acquire(&lock_for_file);
+  int res = file_readv(fd_lookup(fd), iov, iovcnt);
+  lock_release(&lock_for_file);
+  return res;
+}
+
+/* Positional I/O */
+// offset 에서 바로 읽고 씀. file 의 position 은 바꾸지 않음.
+// console 은 위치가 없으므로 -1
+int pread(int fd, void* buffer, unsigned size, unsigned offset){
+  if(!is_user_range(buffer, size)) exit(-1);
+  if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return -1;
+  if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
+  if(offset > INT_MAX) return 0;
+
+  lock_acquire(&lock_for_file);
+  int res = file_read_at(fd_lookup(fd), buffer, size, offset);
+  lock_release(&lock_for_file);
+  return res;
+}
+
+int pwrite(int fd, const void* buffer, unsigned size, unsigned offset){
+  if(!is_user_range(buffer, size)) exit(-1);
+  if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return -1;
+  if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
+  if(offset > INT_MAX) return 0;
+
+  lock_acquire(&lock_for_file);
+  int res = file_write_at(fd_lookup(fd), buffer, size, offset);
+  lock_release(&lock_for_file);
+  return res;
+}
+
+// fd_in 의 현재 위치부터 size byte 를 fd_out 의 현재 위치로 kernel 안에서 복사.
+// user buffer 를 거치지 않고 lock 도 한 번만 잡음. 두 file 의 위치가 모두 전진함
+int copy_file_range(int fd_in, int fd_out, unsigned size){
+  struct file *in, *out;
+
+  if(fd_in == STDIN_FILENO || fd_in == STDOUT_FILENO) return -1;
+  if(fd_out == STDIN_FILENO || fd_out == STDOUT_FILENO) return -1;
+  if(!checkFileValidation((void*)fd_in, FILE_DESC)) exit(-1);
+  if(!checkFileValidation((void*)fd_out, FILE_DESC)) exit(-1);
+  if(size > INT_MAX) size = INT_MAX;
+
+  lock_acquire(&lock_for_file);
+  in = fd_lookup(fd_in);
+  out = fd_lookup(fd_out);
+
+  // 같은 file 안에서 범위가 겹치면 안 됨
+  if(file_get_inode(in) == file_get_inode(out)){
+	off_t in_pos = file_tell(in), out_pos = file_tell(out);
+	if(in_pos < (int64_t)out_pos + size && out_pos < (int64_t)in_pos + size){
+	  lock_release(&lock_for_file);
+	  return -1;
+	}
+  }
+
+  int res = file_copy(out, in, size);
+  lock_release(&lock_for_file);
+  return res;
+}
+
+/* Console input */
+// stdin 을 raw mode(true) 또는 cooked mode(false)로 바꾸고 이전 mode 를 반환
+bool ttyraw(bool raw){
+  return input_set_raw(raw);
+}
+
+int fibonacci(int n){
   
   if(n==1 || n==2) return 1;
 
@@ -258,24 +465,19 @@ int fibonacci(struct intr_frame* f){
   return res;
 }
 
-int max_of_four_int(struct intr_frame* f){
-  int arg[5];
+int max_of_four_int(int a, int b, int c, int d){
+  if(a < b) a = b;
+  if(c < d) c = d;
 
-  for(int i=1; i<=4; i++) arg[i] = (int)*((uint32_t *)(f->esp) + i);
-  
-  if(arg[1] < arg[2]) arg[1] = arg[2];
-  if(arg[3] < arg[4]) arg[3] = arg[4];
-
-  return (arg[1] > arg[3]) ? arg[1] : arg[3];
+  return (a > c) ? a : c;
 }
 
 
 /* Project2 System Call */
-bool create(struct intr_frame* f){
-  const char*file = (const char*)*((uint32_t *)(f->esp)+1);
-  unsigned initial_size = (int)*((uint32_t *)(f->esp)+2);
+bool create(const char* ufile, unsigned initial_size){
+  char file[FILE_NAME_LEN];
 
-  if(!checkFileValidation((void*)file, FILE_NAME)) exit(-1);
+  if(!copyInFileName(file, ufile)) return false;
 
   lock_acquire(&lock_for_file);
   bool success = filesys_create(file, initial_size);
@@ -284,10 +486,10 @@ bool create(struct intr_frame* f){
   return success;
 }
 
-bool remove(struct intr_frame* f){
-  const char* file = (const char*)*((uint32_t *)(f->esp)+1);
+bool remove(const char* ufile){
+  char file[FILE_NAME_LEN];
 
-  if(!checkFileValidation((void*)file, FILE_NAME)) exit(-1);
+  if(!copyInFileName(file, ufile)) return false;
 
   lock_acquire(&lock_for_file);
   bool success = filesys_remove(file);
@@ -296,97 +498,107 @@ bool remove(struct intr_frame* f){
   return success;
 }
 
-int open(struct intr_frame* f){
+int open(const char* ufile){
   
-  const char*file = (const char*)*((uint32_t *)(f->esp)+1);
-  if(!checkFileValidation((void*)file, FILE_NAME)) exit(-1);
+  char file[FILE_NAME_LEN];
+  if(!copyInFileName(file, ufile)) return -1;
   
-  int i;
-  int fd = -1;
-
+  int fd;
   struct file* newFile;
 
-  for(i=3; i<128; i++){
-	if(thread_current()->fd_table[i] != NULL) continue;
+  lock_acquire(&lock_for_file);
+  newFile = filesys_open(file);
+  lock_release(&lock_for_file);
+  if(newFile == NULL) return -1;
+
+  if(strcmp(thread_name(), file) == 0) file_deny_write(newFile);
 
+  // 가장 작은 빈 fd 를 받음
+  fd = fd_install(newFile);
+  if(fd < 0){
 	lock_acquire(&lock_for_file);
-	newFile = filesys_open(file);
+	file_close(newFile);
 	lock_release(&lock_for_file);
-	
-	if(newFile){
-	  fd = i;
-	  thread_current()->fd_table[i] = newFile;
-	  if(strcmp(thread_name(), file) == 0) file_deny_write(newFile);
-	}
-	  
-	break;
   }
 
   return fd;
 
 }
 
-int filesize(struct intr_frame* f){
-  int fd = (int)*((uint32_t*)(f->esp) + 1);
+int filesize(int fd){
   
   if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
   lock_acquire(&lock_for_file);
-  int file_size = file_length(thread_current()->fd_table[fd]);
+  int file_size = file_length(fd_lookup(fd));
   lock_release(&lock_for_file);
 
   return file_size;
 }
 
-void seek(struct intr_frame* f){
+void seek(int fd, unsigned position){
 
-  int fd = (int)*((uint32_t*)(f->esp) + 1);
-  unsigned position = (int)*((uint32_t *)(f->esp)+2);
 
   if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
   lock_acquire(&lock_for_file);
-  file_seek(thread_current()->fd_table[fd], position);
+  file_seek(fd_lookup(fd), position);
   lock_release(&lock_for_file);
   return;
 }
 
-unsigned tell(struct intr_frame* f){
+unsigned tell(int fd){
 
-  int fd = (int)*((uint32_t*)(f->esp) + 1);
   
   if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
   lock_acquire(&lock_for_file);
-  unsigned next_byte = file_tell(thread_current()->fd_table[fd]);
+  unsigned next_byte = file_tell(fd_lookup(fd));
   lock_release(&lock_for_file);
 
   return next_byte;
 }
 
-void close(struct intr_frame* f){
-  int fd = (int)*((uint32_t*)(f->esp) + 1);
+void close(int fd){
   if(!checkFileValidation((void*)fd, FILE_DESC)) exit(-1);
 
+  struct file* file = fd_remove(fd);
+
   lock_acquire(&lock_for_file);
-  file_close(thread_current()->fd_table[fd]);
+  file_close(file);
   lock_release(&lock_for_file);
 
-  thread_current()->fd_table[fd] = NULL;
+  return;
+}
+
+#ifdef VM
+/* Project3 System Call */
+mapid_t mmap(int fd, void* addr){
+
+  // 잘못된 fd 는 process 종료가 아니라 MAP_FAILED
+  if(!checkFileValidation((void*)fd, FILE_DESC)) return MAP_FAILED;
+  return mmap_map(fd_lookup(fd), addr);
+}
+
+void munmap(mapid_t mapping){
 
+  mmap_unmap(mapping);
   return;
 }
 
-bool checkFileValidation(void* param, int flag){
-  if(flag == FILE_NAME){
-	return param != NULL;
-  }
+/* Project3 Additional System Call */
+bool vmstat(struct vmstat* buffer){
+  struct vmstat stats;
 
-  else if(flag == FILE_BUFFER){
-	return is_user_vaddr(param) && param != NULL;
-  }
+  page_get_stats(&stats);
+  if(!copy_to_user(buffer, &stats, sizeof stats)) exit(-1);
+  return true;
+}
+#endif
 
-  else{
+bool checkFileValidation(void* param, int flag){
+  if(flag == FILE_DESC){
 	int fd = (int)param;
-	return thread_current()->fd_table[fd] != NULL && (2 < fd && fd < 128);
+	return fd_lookup(fd) != NULL;
   }
 
+  return false;
 }
   
@@ -1,6 +1,10 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/synch.h"
+
+extern struct lock lock_for_file;
+
 void syscall_init (void);
 void exit(int status);
 #endif /* userprog/syscall.h */
@@ -0,0 +1,101 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory from the kernel.
+
+   Rather than looking every user pointer up in the page
+   directory before touching it, these routines only check that
+   the user range lies below PHYS_BASE and then simply copy,
+   using the primitives in userprog/usercopy.S.  A bad pointer
+   causes a page fault in the kernel, which page_fault() turns
+   into a failure return through uaccess_fixup(). */
+
+/* Primitives and their fault recovery points, in usercopy.S. */
+bool uaccess_copy (void *dst, const void *src, size_t size);
+int uaccess_strncpy (char *dst, const char *src, size_t size);
+extern char uaccess_copy_insn[], uaccess_copy_tail_insn[];
+extern char uaccess_copy_fixup[];
+extern char uaccess_strncpy_insn[], uaccess_strncpy_fixup[];
+
+/* Returns true if the SIZE bytes starting at UADDR all lie below
+   PHYS_BASE.  Says nothing about whether they are mapped. */
+bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Reads the 32-bit word at user address USRC into *DST.
+   Returns true if successful, false if USRC is invalid. */
+bool
+get_user (uint32_t *dst, const void *usrc)
+{
+  return copy_from_user (dst, usrc, sizeof *dst);
+}
+
+/* Writes VALUE as a 32-bit word to user address UDST.
+   Returns true if successful, false if UDST is invalid. */
+bool
+put_user (void *udst, uint32_t value)
+{
+  return copy_to_user (udst, &value, sizeof value);
+}
+
+/* Copies SIZE bytes from user address USRC to DST.
+   Returns true if successful, false if any byte of the user
+   range is invalid. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && uaccess_copy (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.
+   Returns true if successful, false if any byte of the user
+   range is invalid or read-only. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && uaccess_copy (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC to DST,
+   which has room for SIZE bytes.  Returns the length of the
+   string, or SIZE if it does not fit, in which case DST is not
+   null-terminated.  Returns -1 if USRC is invalid. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t room;
+  int len;
+
+  if (!is_user_vaddr (usrc))
+    return -1;
+  room = (const uint8_t *) PHYS_BASE - (const uint8_t *) usrc;
+  if (size <= room)
+    return uaccess_strncpy (dst, usrc, size);
+
+  /* Fail if the string would run into kernel memory. */
+  len = uaccess_strncpy (dst, usrc, room);
+  return len < (int) room ? len : -1;
+}
+
+/* If F is a page fault in one of the primitives above, makes it
+   resume at the primitive's recovery point and returns true.
+   Otherwise returns false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  void *eip = (void *) f->eip;
+
+  if (eip == uaccess_copy_insn || eip == uaccess_copy_tail_insn)
+    f->eip = (void (*) (void)) uaccess_copy_fixup;
+  else if (eip == uaccess_strncpy_insn)
+    f->eip = (void (*) (void)) uaccess_strncpy_fixup;
+  else
+    return false;
+  return true;
+}
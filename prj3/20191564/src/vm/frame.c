@@ -0,0 +1,666 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Every frame currently holding a user page, in clock order. */
+static struct list frames;
+
+/* Clock hand: the next frame to consider for eviction, or the
+   end of FRAMES to start over at the beginning. */
+static struct list_elem *hand;
+
+/* Shared frames, keyed by inode and offset. */
+static struct hash shared_frames;
+
+/* Frames whose contents the merge thread found stable, keyed by
+   checksum, mapped read-only by every page on them. */
+static struct hash merged_frames;
+
+/* Next frame for the merge thread to scan, or the end of FRAMES. */
+static struct list_elem *merge_hand;
+
+/* Protects FRAMES, HAND, SHARED_FRAMES, MERGED_FRAMES,
+   MERGE_HAND, the merge statistics, and the PINNED, PAGES,
+   MERGED and CHECKSUM members of every frame. */
+static struct lock frame_lock;
+
+size_t merge_scan_rate;
+
+/* The merge thread wakes up this often. */
+#define MERGE_INTERVAL (TIMER_FREQ / 10)
+
+/* Statistics. */
+static long long merge_cnt;     /* Pages merged into another frame. */
+static long long unmerge_cnt;   /* Pages copied out on a write. */
+
+static struct frame *frame_new (void);
+static void frame_remove (struct frame *);
+static struct frame *frame_evict (void);
+static struct frame *clock_advance (void);
+static bool lock_pages (struct frame *);
+static void unlock_pages (struct frame *);
+static bool test_and_clear_accessed (struct frame *);
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
+static thread_func merge_thread;
+static void merge_scan (void);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  hash_init (&shared_frames, share_hash, share_less, NULL);
+  hash_init (&merged_frames, merge_hash, merge_less, NULL);
+  merge_hand = list_end (&frames);
+  lock_init (&frame_lock);
+
+  if (merge_scan_rate > 0)
+    thread_create ("merge", PRI_MIN, merge_thread, NULL);
+}
+
+/* Obtains a frame from the user pool to hold page P of the
+   running process, evicting another page if the pool is
+   exhausted.  The frame is returned pinned and private to P;
+   call frame_unpin() once P is mapped.  Returns a null pointer
+   if no frame could be freed. */
+struct frame *
+frame_alloc (struct page *p)
+{
+  struct frame *f = frame_try_alloc (p);
+
+  if (f == NULL)
+    {
+      f = frame_evict ();
+      if (f != NULL)
+        list_push_back (&f->pages, &p->frame_elem);
+    }
+  return f;
+}
+
+/* Like frame_alloc(), but returns a null pointer instead of
+   evicting a page if the user pool is exhausted. */
+struct frame *
+frame_try_alloc (struct page *p)
+{
+  struct frame *f = frame_new ();
+
+  if (f != NULL)
+    list_push_back (&f->pages, &p->frame_elem);
+  return f;
+}
+
+/* Takes a free page from the user pool and enters it in the
+   frame table, pinned and without pages.  Returns a null pointer
+   if the user pool is exhausted. */
+static struct frame *
+frame_new (void)
+{
+  struct frame *f;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+  f->pinned = true;
+  f->inode = NULL;
+  f->merged = false;
+  f->checksum = 0;
+  list_init (&f->pages);
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Makes F a candidate for eviction again. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pinned);
+  f->pinned = false;
+  lock_release (&frame_lock);
+}
+
+/* Detaches page P, which the caller must already have unmapped,
+   from frame F.  If no other page maps F, removes F from the
+   frame table and returns it to the user pool. */
+void
+frame_release (struct frame *f, struct page *p)
+{
+  lock_acquire (&frame_lock);
+  list_remove (&p->frame_elem);
+  if (!list_empty (&f->pages))
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+  frame_remove (f);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Removes F, which no page maps any longer, from the frame table
+   and the shared and merged frame tables, leaving it to the
+   caller to free.  The caller must hold frame_lock. */
+static void
+frame_remove (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (list_empty (&f->pages));
+
+  if (f->inode != NULL)
+    hash_delete (&shared_frames, &f->share_elem);
+  if (f->merged)
+    hash_delete (&merged_frames, &f->merge_elem);
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  if (merge_hand == &f->elem)
+    merge_hand = list_next (merge_hand);
+  list_remove (&f->elem);
+}
+
+/* Tries to satisfy a fault on read-only executable page P of the
+   running process with a frame that another process already
+   read the same contents into.  On success, maps P to that frame
+   read-only and returns true.  Returns false if there is no such
+   frame, in which case the caller should read P itself. */
+bool
+frame_share (struct page *p)
+{
+  struct frame key;
+  struct hash_elem *e;
+  bool success = false;
+
+  key.inode = file_get_inode (p->file);
+  key.ofs = p->ofs;
+
+  lock_acquire (&frame_lock);
+  e = hash_find (&shared_frames, &key.share_elem);
+  if (e != NULL)
+    {
+      struct frame *f = hash_entry (e, struct frame, share_elem);
+      if (f->read_bytes == p->read_bytes
+          && pagedir_set_page (p->owner->pagedir, p->upage, f->kpage, false))
+        {
+          list_push_back (&f->pages, &p->frame_elem);
+          p->frame = f;
+          success = true;
+        }
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Offers F, which holds a freshly read read-only executable page
+   and is still pinned, to other processes via frame_share().
+   If another frame with the same contents got there first, F
+   simply stays private.  Shared frames are keyed by inode and
+   offset alone, which is only safe because a running executable
+   cannot be written: load() denies writes to it until the last
+   process mapping F exits. */
+void
+frame_publish (struct frame *f)
+{
+  struct page *p = list_entry (list_front (&f->pages), struct page,
+                               frame_elem);
+
+  ASSERT (f->pinned);
+  ASSERT (inode_write_denied (file_get_inode (p->file)));
+
+  lock_acquire (&frame_lock);
+  f->inode = file_get_inode (p->file);
+  f->ofs = p->ofs;
+  f->read_bytes = p->read_bytes;
+  if (hash_insert (&shared_frames, &f->share_elem) != NULL)
+    f->inode = NULL;
+  lock_release (&frame_lock);
+}
+
+/* Gives page P, which the running process just tried to write,
+   a writable frame of its own again after the merge thread made
+   it share a read-only frame.  The caller must hold P's lock.  If
+   P is the only page left on its frame, the frame is simply made
+   writable; otherwise P gets a copy in a new frame, evicting
+   another page if necessary.  P's current frame stays pinned
+   meanwhile, so that the evictor leaves it, and P, alone.
+   Returns true if successful, false if no frame could be found. */
+bool
+frame_unmerge (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  struct frame *f = p->frame, *copy;
+  bool success;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (f != NULL);
+
+  lock_acquire (&frame_lock);
+  if (list_size (&f->pages) == 1)
+    {
+      if (f->merged)
+        {
+          hash_delete (&merged_frames, &f->merge_elem);
+          f->merged = false;
+        }
+      lock_release (&frame_lock);
+      pagedir_clear_page (pd, p->upage);
+      return pagedir_set_page (pd, p->upage, f->kpage, true);
+    }
+
+  /* Nobody else pins F while we hold P's lock: loading, evicting
+     and merging all need it. */
+  ASSERT (!f->pinned);
+  f->pinned = true;
+  lock_release (&frame_lock);
+
+  /* F cannot go away or change meanwhile: P is on it, read-only,
+     and F is pinned. */
+  copy = frame_new ();
+  if (copy == NULL)
+    copy = frame_evict ();
+  if (copy == NULL)
+    {
+      frame_unpin (f);
+      return false;
+    }
+  memcpy (copy->kpage, f->kpage, PGSIZE);
+
+  lock_acquire (&frame_lock);
+  list_remove (&p->frame_elem);
+  list_push_back (&copy->pages, &p->frame_elem);
+  unmerge_cnt++;
+  if (list_empty (&f->pages))
+    frame_remove (f);
+  else
+    {
+      f->pinned = false;
+      f = NULL;
+    }
+  lock_release (&frame_lock);
+  if (f != NULL)
+    {
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+
+  pagedir_clear_page (pd, p->upage);
+  success = pagedir_set_page (pd, p->upage, copy->kpage, true);
+  p->frame = copy;
+  frame_unpin (copy);
+  return success;
+}
+
+/* Chooses a victim with the clock (second chance) algorithm,
+   writes its pages out, and returns the frame pinned for reuse,
+   with no pages.
+   Returns a null pointer if every frame is pinned or busy, or
+   if the victim cannot be written out.  In the latter case, the
+   pages that were written out are detached from the victim, and
+   the rest stay on it, mapped. */
+static struct frame *
+frame_evict (void)
+{
+  size_t tries;
+
+  lock_acquire (&frame_lock);
+  for (tries = 2 * list_size (&frames); tries > 0; tries--)
+    {
+      struct frame *f = clock_advance ();
+      struct list_elem *e;
+      bool success = true;
+
+      /* Skip frames being loaded or evicted, and frames with a
+         page whose owner is busy with it (faulting it in or
+         tearing down its address space). */
+      if (f->pinned || !lock_pages (f))
+        continue;
+
+      /* Second chance for recently used frames. */
+      if (test_and_clear_accessed (f))
+        {
+          unlock_pages (f);
+          continue;
+        }
+
+      /* Write the victim out without holding the frame table, so
+         that other processes can keep faulting meanwhile.  A
+         shared frame must stop being found by frame_share()
+         first. */
+      f->pinned = true;
+      if (f->inode != NULL)
+        {
+          hash_delete (&shared_frames, &f->share_elem);
+          f->inode = NULL;
+        }
+      if (f->merged)
+        {
+          hash_delete (&merged_frames, &f->merge_elem);
+          f->merged = false;
+        }
+      f->checksum = 0;
+      lock_release (&frame_lock);
+
+      /* Detach each page as soon as it is out, so that a failure
+         partway leaves only resident pages on F. */
+      e = list_begin (&f->pages);
+      while (e != list_end (&f->pages))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+
+          if (!page_evict (p))
+            {
+              success = false;
+              break;
+            }
+          lock_acquire (&frame_lock);
+          e = list_remove (e);
+          lock_release (&frame_lock);
+          lock_release (&p->lock);
+        }
+      unlock_pages (f);
+
+      if (!success)
+        {
+          frame_unpin (f);
+          return NULL;
+        }
+      return f;
+    }
+  lock_release (&frame_lock);
+  return NULL;
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the frame table.  FRAMES must
+   not be empty. */
+static struct frame *
+clock_advance (void)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (!list_empty (&frames));
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Tries to acquire the lock of every page mapping F without
+   waiting.  Returns true if successful, otherwise releases the
+   locks it did get and returns false.  A page whose lock the
+   running thread already holds counts as busy: it is in the
+   middle of loading or copying that page. */
+static bool
+lock_pages (struct frame *f)
+{
+  struct list_elem *e, *e2;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct lock *lock = &list_entry (e, struct page, frame_elem)->lock;
+      if (lock_held_by_current_thread (lock) || !lock_try_acquire (lock))
+        {
+          for (e2 = list_begin (&f->pages); e2 != e; e2 = list_next (e2))
+            lock_release (&list_entry (e2, struct page, frame_elem)->lock);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Releases the locks acquired by lock_pages(). */
+static void
+unlock_pages (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    lock_release (&list_entry (e, struct page, frame_elem)->lock);
+}
+
+/* Returns true if any page mapping F has been accessed since
+   the last call, and clears the accessed bits of all of them. */
+static bool
+test_and_clear_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Returns a hash value for the shared frame in E. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if the shared frame in A precedes the one in B. */
+static bool
+share_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct frame *fa = hash_entry (a, struct frame, share_elem);
+  const struct frame *fb = hash_entry (b, struct frame, share_elem);
+  if (fa->inode != fb->inode)
+    return fa->inode < fb->inode;
+  return fa->ofs < fb->ofs;
+}
+
+/* Same-page merging.
+
+   The merge thread walks the frame table at merge_scan_rate
+   frames per second, looking at frames that hold one writable,
+   non-mmap page.  A frame whose checksum matches a frame in
+   MERGED_FRAMES, or whose checksum has not changed since the
+   last visit, has its page mapped read-only and its contents
+   compared byte for byte under frame_lock.  An identical page is
+   moved onto the frame in the table and its own frame freed;
+   otherwise the frame itself joins the table, so that later
+   copies can be merged into it.  Merged pages become PAGE_SWAP
+   pages, since their contents may no longer match their file. */
+
+/* Scans part of the frame table every MERGE_INTERVAL ticks. */
+static void
+merge_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      size_t i;
+
+      timer_sleep (MERGE_INTERVAL);
+      for (i = 0; i < merge_scan_rate * MERGE_INTERVAL / TIMER_FREQ
+                  || i == 0; i++)
+        merge_scan ();
+    }
+}
+
+/* Returns the frame under the merge hand and advances the hand,
+   like clock_advance(), or a null pointer if FRAMES is empty. */
+static struct frame *
+merge_advance (void)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (list_empty (&frames))
+    return NULL;
+  if (merge_hand == list_end (&frames))
+    merge_hand = list_begin (&frames);
+  f = list_entry (merge_hand, struct frame, elem);
+  merge_hand = list_next (merge_hand);
+  return f;
+}
+
+/* Scans the frame under the merge hand, merging it into an
+   identical frame if there is one. */
+static void
+merge_scan (void)
+{
+  struct frame *f, *g;
+  struct hash_elem *e;
+  struct page *p;
+  uint32_t *pd;
+  unsigned checksum;
+  bool stable;
+
+  /* Pick a private frame holding a writable page, and pin it so
+     that it is neither evicted nor freed under us. */
+  lock_acquire (&frame_lock);
+  f = merge_advance ();
+  if (f == NULL || f->pinned || f->inode != NULL || f->merged
+      || list_size (&f->pages) != 1)
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+  p = list_entry (list_front (&f->pages), struct page, frame_elem);
+  if (!p->writable || p->type == PAGE_MMAP || !lock_try_acquire (&p->lock))
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+  f->pinned = true;
+  lock_release (&frame_lock);
+
+  /* The page may still be written, so this checksum is only a
+     hint. */
+  checksum = hash_bytes (f->kpage, PGSIZE);
+  lock_acquire (&frame_lock);
+  stable = checksum == f->checksum;
+  f->checksum = checksum;
+  if (!stable)
+    stable = hash_find (&merged_frames, &f->merge_elem) != NULL;
+  lock_release (&frame_lock);
+  if (!stable)
+    goto done;
+
+  /* Write-protect the page, then hash it again for real. */
+  pd = p->owner->pagedir;
+  pagedir_clear_page (pd, p->upage);
+  if (!pagedir_set_page (pd, p->upage, f->kpage, false))
+    NOT_REACHED ();
+  p->type = PAGE_SWAP;
+  checksum = hash_bytes (f->kpage, PGSIZE);
+
+  lock_acquire (&frame_lock);
+  f->checksum = checksum;
+  e = hash_find (&merged_frames, &f->merge_elem);
+  g = e != NULL ? hash_entry (e, struct frame, merge_elem) : NULL;
+  if (g == NULL)
+    {
+      hash_insert (&merged_frames, &f->merge_elem);
+      f->merged = true;
+    }
+  else if (!g->pinned && !memcmp (g->kpage, f->kpage, PGSIZE))
+    {
+      /* G stays alive and read-only while frame_lock is held. */
+      pagedir_clear_page (pd, p->upage);
+      if (!pagedir_set_page (pd, p->upage, g->kpage, false))
+        NOT_REACHED ();
+      list_remove (&p->frame_elem);
+      list_push_back (&g->pages, &p->frame_elem);
+      p->frame = g;
+      frame_remove (f);
+      merge_cnt++;
+      lock_release (&frame_lock);
+      lock_release (&p->lock);
+      palloc_free_page (f->kpage);
+      free (f);
+      return;
+    }
+  lock_release (&frame_lock);
+
+ done:
+  frame_unpin (f);
+  lock_release (&p->lock);
+}
+
+/* Prints same-page merging statistics, if it is enabled. */
+void
+frame_print_stats (void)
+{
+  struct hash_iterator i;
+  size_t shared = 0, saved = 0;
+
+  if (merge_scan_rate == 0)
+    return;
+
+  lock_acquire (&frame_lock);
+  hash_first (&i, &merged_frames);
+  while (hash_next (&i))
+    {
+      struct frame *f = hash_entry (hash_cur (&i), struct frame, merge_elem);
+      size_t cnt = list_size (&f->pages);
+      if (cnt > 1)
+        {
+          shared++;
+          saved += cnt - 1;
+        }
+    }
+  lock_release (&frame_lock);
+  printf ("Merging: %lld pages merged, %lld copied on write, "
+          "%zu frames shared, %zu frames saved\n",
+          merge_cnt, unmerge_cnt, shared, saved);
+}
+
+/* Returns a hash value for the merged frame in E. */
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct frame, merge_elem)->checksum;
+}
+
+/* Returns true if the merged frame in A precedes the one in B. */
+static bool
+merge_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct frame, merge_elem)->checksum
+          < hash_entry (b, struct frame, merge_elem)->checksum);
+}
@@ -0,0 +1,56 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct page;
+
+/* A frame of the user pool holding one user page.
+
+   Most frames are private to one page of one process.  Frames
+   holding read-only pages of an executable are shared: they are
+   entered in a table keyed by the file's inode and offset, and
+   later processes running the same program map the same frame
+   instead of reading their own copy.  Frames holding anonymous
+   pages may also be shared, read-only, once the merge thread
+   finds that their contents are identical; a write fault then
+   gives the writer a private copy again. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapping this frame. */
+    bool pinned;                /* Never chosen for eviction if true. */
+    struct list_elem elem;      /* Element in the frame table. */
+
+    /* Key in the table of shared frames, if INODE is nonnull. */
+    struct inode *inode;        /* Inode the contents came from. */
+    off_t ofs;                  /* Offset in INODE. */
+    uint32_t read_bytes;        /* Bytes read; the rest are zeros. */
+    struct hash_elem share_elem; /* Element in shared frame table. */
+
+    /* Same-page merging. */
+    bool merged;                /* In the merged frame table? */
+    unsigned checksum;          /* Contents hash at the last scan. */
+    struct hash_elem merge_elem; /* Element in merged frame table. */
+  };
+
+/* Frames scanned per second by the merge thread, set by the
+   -merge option.  0, the default, disables same-page merging. */
+extern size_t merge_scan_rate;
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+void frame_unpin (struct frame *);
+void frame_release (struct frame *, struct page *);
+
+bool frame_share (struct page *);
+void frame_publish (struct frame *);
+bool frame_unmerge (struct page *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
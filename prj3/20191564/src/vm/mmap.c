@@ -0,0 +1,149 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/page.h"
+
+static struct mmap_region *mmap_find (mapid_t);
+static void mmap_release (struct mmap_region *);
+
+/* Maps FILE into the running process's address space starting
+   at user page ADDR.  Pages are read from the file on first
+   access and written back to it only if they are modified.  The
+   mapping has its own reopening of FILE, so it stays valid after
+   the caller closes FILE.
+   Returns the new mapping's identifier, or MAP_FAILED if ADDR is
+   null or not page-aligned, FILE is empty, or any page of the
+   mapping would overlap pages already in use. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mmap_region *m;
+  off_t length;
+  size_t page_cnt;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr))
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+
+  lock_acquire (&lock_for_file);
+  length = file_length (file);
+  m->file = length > 0 ? file_reopen (file) : NULL;
+  lock_release (&lock_for_file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+
+  /* M owns no pages until they are added below, so that
+     releasing it on failure leaves existing pages alone. */
+  m->addr = addr;
+  m->page_cnt = 0;
+  page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  if (page_cnt > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) addr) / PGSIZE)
+    {
+      mmap_release (m);
+      return MAP_FAILED;
+    }
+  for (i = 0; i < page_cnt; i++)
+    if (page_lookup ((uint8_t *) addr + i * PGSIZE) != NULL)
+      {
+        mmap_release (m);
+        return MAP_FAILED;
+      }
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      off_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mmap ((uint8_t *) addr + ofs, m->file, ofs, read_bytes))
+        {
+          mmap_release (m);
+          return MAP_FAILED;
+        }
+      m->page_cnt++;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mmaps, &m->elem);
+  return m->id;
+}
+
+/* Removes mapping MAPPING from the running process, writing
+   modified pages back to the file.  Does nothing if MAPPING is
+   not one of the process's mappings. */
+void
+mmap_unmap (mapid_t mapping)
+{
+  struct mmap_region *m = mmap_find (mapping);
+
+  if (m != NULL)
+    {
+      list_remove (&m->elem);
+      mmap_release (m);
+    }
+}
+
+/* Removes all of the running process's mappings, writing
+   modified pages back to their files. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mmaps = &thread_current ()->mmaps;
+
+  while (!list_empty (mmaps))
+    {
+      struct mmap_region *m = list_entry (list_pop_front (mmaps),
+                                          struct mmap_region, elem);
+      mmap_release (m);
+    }
+}
+
+/* Returns the running process's mapping with identifier
+   MAPPING, or a null pointer if there is none. */
+static struct mmap_region *
+mmap_find (mapid_t mapping)
+{
+  struct list *mmaps = &thread_current ()->mmaps;
+  struct list_elem *e;
+
+  for (e = list_begin (mmaps); e != list_end (mmaps); e = list_next (e))
+    {
+      struct mmap_region *m = list_entry (e, struct mmap_region, elem);
+      if (m->id == mapping)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes the pages of M from the address space, closes its
+   file, and frees M.  The pages are unmapped as one batch first,
+   so that removing them one by one needn't flush the TLB for
+   each. */
+static void
+mmap_release (struct mmap_region *m)
+{
+  size_t i;
+
+  pagedir_clear_pages (thread_current ()->pagedir, m->addr, m->page_cnt);
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->addr + i * PGSIZE);
+
+  lock_acquire (&lock_for_file);
+  file_close (m->file);
+  lock_release (&lock_for_file);
+  free (m);
+}
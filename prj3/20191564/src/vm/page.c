@@ -0,0 +1,690 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* PUSHA pushes 32 bytes before it moves the stack pointer, so a
+   fault this far below the user's esp is still a stack access. */
+#define STACK_SLACK 32
+
+size_t stack_page_limit = STACK_PAGES_DEFAULT;
+
+/* A fault on a file-backed page first reads this many pages,
+   counting the faulting page, and doubles the window up to
+   read_ahead_limit pages each time the process faults right past
+   the pages read ahead the last time. */
+#define READ_AHEAD_MIN 4
+
+size_t read_ahead_limit = READ_AHEAD_DEFAULT;
+
+/* Number of pages brought in by read-ahead. */
+static long long read_ahead_cnt;
+
+/* Number of pages swapped in along with a neighbour. */
+static long long swap_around_cnt;
+
+/* A page of zeros, mapped read-only in place of every PAGE_ZERO
+   page that has been read but never written, so that large BSS
+   arrays and untouched stack cost neither a frame nor a memset
+   until they are modified. */
+static void *zero_kpage;
+
+/* Number of read faults satisfied with ZERO_KPAGE. */
+static long long zero_map_cnt;
+
+/* A process's working set is sampled at most this often: the
+   pages it accessed since the last sample, found and cleared in
+   the accessed bits of its page directory. */
+#define WORKING_SET_INTERVAL (TIMER_FREQ / 10)
+
+bool page_stats_on_exit;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void page_destructor (struct hash_elem *, void *aux);
+static bool page_add (struct page *);
+static bool page_read_in (struct page *, void *kpage);
+static void page_write_back (struct page *, uint32_t *pd);
+static bool page_shareable (const struct page *);
+static bool page_load (struct page *, bool evict, bool *major);
+static void page_read_ahead (struct page *);
+static void page_swap_around (struct page *, size_t slot);
+
+/* Initializes the shared zero page. */
+void
+page_init (void)
+{
+  zero_kpage = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+/* Creates an empty supplemental page table.
+   Returns the new table, or a null pointer if memory allocation
+   fails. */
+struct hash *
+page_table_create (void)
+{
+  struct hash *pages = malloc (sizeof *pages);
+  if (pages != NULL && !hash_init (pages, page_hash, page_less, NULL))
+    {
+      free (pages);
+      pages = NULL;
+    }
+  return pages;
+}
+
+/* Destroys supplemental page table PAGES, which must belong to
+   the running thread, freeing every frame and swap slot it still
+   holds. */
+void
+page_table_destroy (struct hash *pages)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if (pages == NULL)
+    return;
+
+  /* Unmap the whole user address space in one batch, so that the
+     destructor needn't flush the TLB page by page. */
+  if (pd != NULL)
+    pagedir_clear_pages (pd, NULL, (uintptr_t) PHYS_BASE / PGSIZE);
+  hash_destroy (pages, page_destructor);
+  free (pages);
+}
+
+/* Returns the running process's page table entry for user page
+   UPAGE, or a null pointer if UPAGE is not part of its address
+   space. */
+struct page *
+page_lookup (const void *upage)
+{
+  struct hash *pages = thread_current ()->pages;
+  struct page p;
+  struct hash_elem *e;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  if (pages == NULL)
+    return NULL;
+  p.upage = (void *) upage;
+  e = hash_find (pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Records that user page UPAGE is to be filled with READ_BYTES
+   bytes of FILE starting at offset OFS, followed by ZERO_BYTES
+   zeros, the first time it is accessed.  Nothing is read now.
+   Returns true if successful, false if UPAGE is already in use
+   or memory allocation fails. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes, uint32_t zero_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes + zero_bytes == PGSIZE);
+
+  if (read_bytes == 0)
+    return page_add_zero (upage, writable);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->writable = writable;
+  p->type = PAGE_FILE;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->zero_bytes = zero_bytes;
+  return page_add (p);
+}
+
+/* Records that user page UPAGE is to be zero-filled the first
+   time it is accessed.
+   Returns true if successful, false if UPAGE is already in use
+   or memory allocation fails. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  struct page *p = malloc (sizeof *p);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->writable = writable;
+  p->type = PAGE_ZERO;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  p->zero_bytes = PGSIZE;
+  return page_add (p);
+}
+
+/* Records that user page UPAGE maps READ_BYTES bytes of FILE
+   starting at offset OFS, followed by zeros to the end of the
+   page.  The page is read on first access like one added with
+   page_add_file(), but if it is modified, it is written back to
+   FILE, not to swap, when it is evicted or removed.
+   Returns true if successful, false if UPAGE is already in use
+   or memory allocation fails. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->writable = true;
+  p->type = PAGE_MMAP;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->zero_bytes = PGSIZE - read_bytes;
+  return page_add (p);
+}
+
+/* Removes user page UPAGE from the running process's address
+   space, writing it back first if it is a modified mapped page,
+   and frees its frame or swap slot.  UPAGE need not be part of
+   the address space. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (upage);
+
+  if (p == NULL)
+    return;
+
+  hash_delete (t->pages, &p->hash_elem);
+  page_destructor (&p->hash_elem, NULL);
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it
+   into the running process's page directory.  WRITE tells
+   whether the faulting access was a write.
+
+   A read of a PAGE_ZERO page maps the shared zero page
+   read-only.  A later write to it faults again, and only then
+   gets a frame of its own, as does a write to a page sharing a
+   frame with identical pages (see frame_unmerge()).  For a page
+   backed by a file, also
+   reads ahead the pages that follow it (see page_read_ahead()).
+
+   Counts the fault as minor or major in the process's vmstat.
+
+   Returns true if successful, false if FAULT_ADDR is not part of
+   the process's address space, is already in a frame, or no
+   frame can be found for it. */
+bool
+page_fault_in (const void *fault_addr, bool write)
+{
+  struct page *p;
+  size_t slot = SWAP_ERROR;
+  bool success = false;
+  bool major = false;
+
+  if (!is_user_vaddr (fault_addr))
+    return false;
+  p = page_lookup (pg_round_down (fault_addr));
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  if (p->frame == NULL)
+    {
+      uint32_t *pd = p->owner->pagedir;
+
+      slot = p->swap_slot;
+
+      if (p->type == PAGE_ZERO && !write)
+        {
+          success = pagedir_set_page (pd, p->upage, zero_kpage, false);
+          if (success)
+            zero_map_cnt++;
+        }
+      else if (!write || p->writable)
+        {
+          /* Drop the zero page, if it is mapped, before mapping a
+             frame of our own. */
+          pagedir_clear_page (pd, p->upage);
+          success = page_load (p, true, &major);
+        }
+    }
+  else if (write && p->writable)
+    {
+      /* A write to a page the merge thread made read-only. */
+      success = frame_unmerge (p);
+    }
+  else if (!write)
+    {
+      /* The merge thread remaps pages while holding their locks,
+         so the page may have become present while we waited. */
+      success = pagedir_get_page (p->owner->pagedir, p->upage) != NULL;
+    }
+  lock_release (&p->lock);
+
+  if (success && major)
+    p->owner->vmstat.major_faults++;
+  else if (success)
+    p->owner->vmstat.minor_faults++;
+
+  if (success && (p->type == PAGE_FILE || p->type == PAGE_MMAP))
+    page_read_ahead (p);
+  else if (success && slot != SWAP_ERROR)
+    page_swap_around (p, slot);
+  return success;
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages read ahead, %lld swapped in around faults, "
+          "%lld zero page mappings\n",
+          read_ahead_cnt, swap_around_cnt, zero_map_cnt);
+}
+
+/* Samples the running process's working set if
+   WORKING_SET_INTERVAL ticks have passed since the last sample.
+   Called on entry to the kernel from the process, on page faults
+   and system calls, since only the owner walks its page table.
+
+   The clock hand in vm/frame.c clears accessed bits too, so a
+   page it passes over between samples is missed; the sample is
+   a lower bound. */
+void
+page_sample_working_set (void)
+{
+  struct thread *t = thread_current ();
+  int64_t now = timer_ticks ();
+  struct hash_iterator i;
+  unsigned cnt = 0;
+
+  if (t->pages == NULL || now - t->working_set_tick < WORKING_SET_INTERVAL)
+    return;
+  t->working_set_tick = now;
+
+  hash_first (&i, t->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      if (pagedir_get_page (t->pagedir, p->upage) != NULL
+          && pagedir_is_accessed (t->pagedir, p->upage))
+        {
+          pagedir_set_accessed (t->pagedir, p->upage, false);
+          cnt++;
+        }
+    }
+  t->vmstat.working_set = cnt;
+  if (cnt > t->vmstat.peak_working_set)
+    t->vmstat.peak_working_set = cnt;
+}
+
+/* Stores the running process's virtual memory statistics in
+   *STATS. */
+void
+page_get_stats (struct vmstat *stats)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  *stats = t->vmstat;
+  stats->resident = 0;
+  if (t->pages == NULL)
+    return;
+  hash_first (&i, t->pages);
+  while (hash_next (&i))
+    if (hash_entry (hash_cur (&i), struct page, hash_elem)->frame != NULL)
+      stats->resident++;
+}
+
+/* Prints the running process's virtual memory statistics, if the
+   -vmstat option was given. */
+void
+page_print_process_stats (void)
+{
+  struct vmstat s;
+
+  if (!page_stats_on_exit)
+    return;
+  page_get_stats (&s);
+  printf ("%s: vmstat: %u minor faults, %u major faults, "
+          "%u swapped in, %u swapped out, %u resident, "
+          "working set %u (peak %u)\n",
+          thread_name (), s.minor_faults, s.major_faults,
+          s.swap_ins, s.swap_outs, s.resident,
+          s.working_set, s.peak_working_set);
+}
+
+/* Extends the running process's stack down to the page
+   containing FAULT_ADDR, if the fault looks like a stack access:
+   at most STACK_SLACK bytes below ESP, the user stack pointer at
+   the time of the fault, and within stack_page_limit pages of
+   PHYS_BASE.  The new page is zeroed and mapped immediately.
+   Returns true if successful, false if the fault is not a stack
+   access or no frame can be found. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp)
+{
+  const uint8_t *addr = fault_addr;
+  void *upage = pg_round_down (fault_addr);
+
+  if (!is_user_vaddr (addr)
+      || (size_t) ((uint8_t *) PHYS_BASE - addr) > stack_page_limit * PGSIZE
+      || addr + STACK_SLACK < (const uint8_t *) esp)
+    return false;
+
+  return page_add_zero (upage, true) && page_fault_in (upage, true);
+}
+
+/* Unmaps P, which must be resident, from its owner's page
+   directory and saves its contents if they cannot be recreated:
+   dirty mapped pages go back to their file, anonymous pages and
+   other dirty pages go to swap, and clean pages are simply
+   dropped and read in again later.
+   The caller must hold P's lock and keep its frame pinned; the
+   frame itself is left allocated for reuse.  P's frame_elem is
+   left for the caller to dispose of.
+   Returns true if successful, false if swap is full, in which
+   case P stays mapped. */
+bool
+page_evict (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  bool dirty;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  /* Clear the mapping first so that the owner cannot dirty the
+     page after we looked at the dirty bit. */
+  pagedir_clear_page (pd, p->upage);
+  dirty = pagedir_is_dirty (pd, p->upage);
+  if (p->type == PAGE_MMAP)
+    page_write_back (p, pd);
+  else if (dirty || p->type == PAGE_SWAP)
+    {
+      size_t slot = swap_out (p->frame->kpage);
+      if (slot == SWAP_ERROR)
+        {
+          pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, dirty);
+          return false;
+        }
+      p->type = PAGE_SWAP;
+      p->swap_slot = slot;
+      p->owner->vmstat.swap_outs++;
+    }
+  p->frame = NULL;
+  return true;
+}
+
+/* Reads P, whose lock the caller must hold and which must not be
+   resident, into a frame and maps it into its owner's page
+   directory.  Read-only executable pages reuse a frame another
+   process already read them into, if there is one.  If EVICT is
+   false, only a free frame is used, never one obtained by
+   evicting another page.  If MAJOR is nonnull, sets *MAJOR to
+   whether the page had to be read from its file or from swap.
+   Returns true if successful, false otherwise. */
+static bool
+page_load (struct page *p, bool evict, bool *major)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame == NULL);
+
+  if (major != NULL)
+    *major = false;
+  if (page_shareable (p) && frame_share (p))
+    return true;
+
+  f = evict ? frame_alloc (p) : frame_try_alloc (p);
+  if (f == NULL)
+    return false;
+  if (!page_read_in (p, f->kpage)
+      || !pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                            p->writable))
+    {
+      frame_release (f, p);
+      return false;
+    }
+  if (major != NULL)
+    *major = p->type == PAGE_SWAP || p->read_bytes > 0;
+  p->frame = f;
+  if (page_shareable (p))
+    frame_publish (f);
+  frame_unpin (f);
+  return true;
+}
+
+/* Maps the pages that follow file-backed page P, which was just
+   faulted in, as long as they come from the same file and free
+   frames are available, so that a process walking through code
+   or a mapped file takes one fault per window instead of one per
+   page.  The window grows while the faults stay sequential.
+
+   Pages read ahead are mapped with their accessed bits clear, so
+   if the process never touches them they are the first to go
+   when memory runs short. */
+static void
+page_read_ahead (struct page *p)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = p->upage;
+  size_t i;
+
+  if (upage == t->read_ahead_next)
+    t->read_ahead_window *= 2;
+  else
+    t->read_ahead_window = READ_AHEAD_MIN;
+  if (t->read_ahead_window > read_ahead_limit)
+    t->read_ahead_window = read_ahead_limit;
+  t->read_ahead_next = upage + t->read_ahead_window * PGSIZE;
+
+  for (i = 1; i < t->read_ahead_window; i++)
+    {
+      struct page *next;
+      bool loaded;
+
+      if (!is_user_vaddr (upage + i * PGSIZE))
+        break;
+      next = page_lookup (upage + i * PGSIZE);
+      if (next == NULL || next->type != p->type || next->file != p->file)
+        break;
+      if (!lock_try_acquire (&next->lock))
+        break;
+      loaded = next->frame != NULL;
+      if (!loaded && page_load (next, false, NULL))
+        {
+          loaded = true;
+          read_ahead_cnt++;
+        }
+      lock_release (&next->lock);
+      if (!loaded)
+        break;
+    }
+}
+
+/* Swaps in the neighbours of page P, which was just read from
+   swap slot SLOT, on either side, as long as they were swapped
+   out to the slots next to SLOT and free frames are available.
+   Swap slots are allocated in clusters (see disk_alloc() in
+   vm/swap.c), so pages of one process evicted together usually
+   sit next to each other on the device and come back with one
+   sequential read instead of one seek per fault.  Like pages
+   read ahead, they are mapped with their accessed bits clear. */
+static void
+page_swap_around (struct page *p, size_t slot)
+{
+  int dir;
+
+  for (dir = 1; dir >= -1; dir -= 2)
+    {
+      uint8_t *upage = p->upage;
+      size_t prev = slot;
+      size_t i;
+
+      for (i = 1; i < SWAP_CLUSTER; i++)
+        {
+          struct page *next;
+          bool loaded = false;
+
+          upage += dir * PGSIZE;
+          if (!is_user_vaddr (upage))
+            break;
+          next = page_lookup (upage);
+          if (next == NULL || !lock_try_acquire (&next->lock))
+            break;
+          if (next->frame == NULL && next->type == PAGE_SWAP
+              && swap_adjacent (prev, next->swap_slot, dir))
+            {
+              prev = next->swap_slot;
+              loaded = page_load (next, false, NULL);
+              if (loaded)
+                swap_around_cnt++;
+            }
+          lock_release (&next->lock);
+          if (!loaded)
+            break;
+        }
+    }
+}
+
+/* Inserts P into the running process's page table, freeing it
+   instead if its page is already present. */
+static bool
+page_add (struct page *p)
+{
+  struct hash *pages = thread_current ()->pages;
+
+  ASSERT (pg_ofs (p->upage) == 0);
+  ASSERT (is_user_vaddr (p->upage));
+
+  p->owner = thread_current ();
+  p->frame = NULL;
+  p->swap_slot = SWAP_ERROR;
+  lock_init (&p->lock);
+  if (pages == NULL || hash_insert (pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return false;
+    }
+  return true;
+}
+
+/* Fills KPAGE with the contents of P, from swap if it was
+   swapped out, otherwise from its file or with zeros.
+   Returns true if successful, false on a short read. */
+static bool
+page_read_in (struct page *p, void *kpage)
+{
+  bool success = true;
+
+  if (p->type == PAGE_SWAP)
+    {
+      /* Swapped in pages only live in memory until evicted. */
+      swap_in (p->swap_slot, kpage);
+      p->owner->vmstat.swap_ins++;
+      p->swap_slot = SWAP_ERROR;
+      return true;
+    }
+  if (p->type == PAGE_FILE || p->type == PAGE_MMAP)
+    {
+      /* A fault taken inside a system call may already hold the
+         file system lock, e.g. while read() fills a buffer that
+         has not been touched yet. */
+      bool locked = !lock_held_by_current_thread (&lock_for_file);
+      if (locked)
+        lock_acquire (&lock_for_file);
+      success = (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+                 == (off_t) p->read_bytes);
+      if (locked)
+        lock_release (&lock_for_file);
+    }
+  memset ((uint8_t *) kpage + p->read_bytes, 0, p->zero_bytes);
+  return success;
+}
+
+/* If P is a mapped page that has been modified since it was
+   read in, writes it back to its file.  P must be resident and
+   belong to page directory PD.
+
+   This does not take lock_for_file.  The evicting thread may
+   hold another process's page lock while that process sleeps
+   on lock_for_file waiting for the very same page, and
+   file_write_at() within a file's length is safe without it. */
+static void
+page_write_back (struct page *p, uint32_t *pd)
+{
+  ASSERT (p->frame != NULL);
+
+  if (p->type == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+    file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+}
+
+/* Returns true if P is a read-only page of an executable, whose
+   frame can be shared by every process running the same program
+   (see frame_share()). */
+static bool
+page_shareable (const struct page *p)
+{
+  return p->type == PAGE_FILE && !p->writable;
+}
+
+/* Frees the frame or swap slot and the entry for the page in
+   E, writing back a modified mapped page first.  Also unmaps the
+   zero page, which must not reach pagedir_destroy().  Waits for any
+   eviction of the page in progress. */
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+  uint32_t *pd = thread_current ()->pagedir;
+
+  lock_acquire (&p->lock);
+  pagedir_clear_page (pd, p->upage);
+  if (p->frame != NULL)
+    {
+      page_write_back (p, pd);
+      frame_release (p->frame, p);
+    }
+  else if (p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  free (p);
+}
+
+/* Returns a hash value for the page in E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if the page in A precedes the page in B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *pa = hash_entry (a, struct page, hash_elem);
+  const struct page *pb = hash_entry (b, struct page, hash_elem);
+  return pa->upage < pb->upage;
+}
@@ -0,0 +1,83 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vmstat.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+/* Where the contents of a user page come from the next time it
+   is brought into memory. */
+enum page_type
+  {
+    PAGE_FILE,                  /* Read from a file, zero the rest. */
+    PAGE_MMAP,                  /* Like PAGE_FILE, written back to it. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP                   /* Anonymous: swap slot when evicted. */
+  };
+
+/* Supplemental page table entry.
+   Describes one page of a process's user virtual address space,
+   whether or not it is currently backed by a frame. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Process whose page this is. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in FRAME's page list. */
+    bool writable;              /* Writable by the user process? */
+    enum page_type type;        /* Backing store. */
+    struct lock lock;           /* Held while loading or evicting. */
+
+    /* For PAGE_FILE and PAGE_MMAP. */
+    struct file *file;          /* File to read from. */
+    off_t ofs;                  /* Offset in FILE. */
+    uint32_t read_bytes;        /* Bytes to read from FILE. */
+    uint32_t zero_bytes;        /* Bytes to zero after READ_BYTES. */
+
+    /* For PAGE_SWAP while FRAME is null. */
+    size_t swap_slot;           /* Slot on the swap device. */
+
+    struct hash_elem hash_elem; /* Element in owner's page table. */
+  };
+
+/* Default for the -sl option: the user stack may grow to 8 MB. */
+#define STACK_PAGES_DEFAULT 2048
+
+/* Maximum number of pages in a user stack. */
+extern size_t stack_page_limit;
+
+/* Default for the -ra option: read ahead up to 64 kB. */
+#define READ_AHEAD_DEFAULT 16
+
+/* Maximum number of pages read per fault on a file-backed page,
+   including the faulting page.  1 disables read-ahead. */
+extern size_t read_ahead_limit;
+
+/* Print each process's vmstat when it exits?  Set by -vmstat. */
+extern bool page_stats_on_exit;
+
+void page_init (void);
+struct hash *page_table_create (void);
+void page_table_destroy (struct hash *);
+
+struct page *page_lookup (const void *upage);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes, uint32_t zero_bytes,
+                    bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes);
+void page_remove (void *upage);
+bool page_fault_in (const void *fault_addr, bool write);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_evict (struct page *);
+void page_print_stats (void);
+void page_sample_working_set (void);
+void page_get_stats (struct vmstat *);
+void page_print_process_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,430 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap slots come in two kinds.  Slots below the number of
+   slots on the swap device name a page on the device.  Slots at
+   or above it name a compressed page in the swap pool, a
+   contiguous run of kernel pages carved into POOL_CHUNK-byte
+   chunks: the slot minus the device slot count is the index of
+   the page's first chunk.  swap_out() tries the pool first and
+   only writes to the device when the page does not compress
+   well or the pool has no room for it. */
+
+/* Number of sectors in one page-sized swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Allocation unit within the swap pool, in bytes. */
+#define POOL_CHUNK 64
+
+/* Pages that do not compress to at most this many bytes go
+   straight to the swap device. */
+#define POOL_MAX_ENTRY (PGSIZE / 2)
+
+/* Header in front of each compressed page in the pool. */
+struct pool_entry
+  {
+    uint16_t size;              /* Bytes of compressed data. */
+    uint8_t data[];             /* Compressed data. */
+  };
+
+size_t swap_pool_pages = SWAP_POOL_DEFAULT;
+
+/* The swap device, or a null pointer if there is none. */
+static struct block *swap_block;
+
+/* Used slots on the swap device, one bit per slot. */
+static struct bitmap *swap_map;
+
+/* Protects swap_map and the current cluster. */
+static struct lock swap_lock;
+
+/* Device slots reserved in swap_map but not handed out yet: the
+   rest of the current cluster, from cluster_next up to but not
+   including cluster_end. */
+static size_t cluster_next, cluster_end;
+
+/* The swap pool, or a null pointer if there is none. */
+static uint8_t *pool;
+
+/* Used chunks in the pool, one bit per chunk. */
+static struct bitmap *pool_map;
+
+/* Protects pool, pool_map, compress_buf and the statistics. */
+static struct lock pool_lock;
+
+/* Compressor output, copied into the pool once its size is
+   known. */
+static uint8_t compress_buf[POOL_MAX_ENTRY];
+
+/* Statistics. */
+static long long pool_store_cnt;    /* Pages stored in the pool. */
+static long long pool_hit_cnt;      /* Pages read back from the pool. */
+static long long disk_in_cnt;       /* Pages read back from the device. */
+static long long pool_raw_bytes;    /* Bytes stored, before compression. */
+static long long pool_packed_bytes; /* Bytes stored, after compression. */
+
+static size_t lz_compress (const uint8_t *src, uint8_t *dst,
+                           size_t dst_size);
+static void lz_decompress (const uint8_t *src, size_t src_size,
+                           uint8_t *dst);
+
+/* Sets up the swap pool and the swap device, if one was assigned
+   the BLOCK_SWAP role.  Without either, swap_out() always
+   fails. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block != NULL)
+    slot_cnt = block_size (swap_block) / SECTORS_PER_SLOT;
+  swap_map = bitmap_create (slot_cnt);
+  if (swap_map == NULL)
+    PANIC ("swap bitmap creation failed--swap device is too large");
+
+  lock_init (&pool_lock);
+  if (swap_pool_pages > 0)
+    {
+      pool = palloc_get_multiple (0, swap_pool_pages);
+      if (pool == NULL)
+        printf ("swap: no room for a %zu page pool, disabled\n",
+                swap_pool_pages);
+      else
+        {
+          pool_map = bitmap_create (swap_pool_pages * PGSIZE / POOL_CHUNK);
+          if (pool_map == NULL)
+            PANIC ("swap pool bitmap creation failed");
+        }
+    }
+}
+
+/* Tries to compress the page at KPAGE into the swap pool.
+   Returns its slot if successful, SWAP_ERROR otherwise. */
+static size_t
+pool_out (const void *kpage)
+{
+  size_t size, chunk = BITMAP_ERROR;
+
+  if (pool == NULL)
+    return SWAP_ERROR;
+
+  lock_acquire (&pool_lock);
+  size = lz_compress (kpage, compress_buf, sizeof compress_buf);
+  if (size > 0)
+    chunk = bitmap_scan_and_flip (pool_map, 0,
+                                  DIV_ROUND_UP (sizeof (struct pool_entry)
+                                                + size, POOL_CHUNK),
+                                  false);
+  if (chunk != BITMAP_ERROR)
+    {
+      struct pool_entry *e = (struct pool_entry *) (pool
+                                                    + chunk * POOL_CHUNK);
+      e->size = size;
+      memcpy (e->data, compress_buf, size);
+      pool_store_cnt++;
+      pool_raw_bytes += PGSIZE;
+      pool_packed_bytes += size;
+    }
+  lock_release (&pool_lock);
+
+  return chunk != BITMAP_ERROR ? bitmap_size (swap_map) + chunk : SWAP_ERROR;
+}
+
+/* Returns the pool entry for SLOT, or a null pointer if SLOT is
+   on the swap device. */
+static struct pool_entry *
+pool_entry (size_t slot)
+{
+  size_t disk_slot_cnt = bitmap_size (swap_map);
+
+  if (slot < disk_slot_cnt)
+    return NULL;
+  ASSERT (pool != NULL);
+  ASSERT (bitmap_test (pool_map, slot - disk_slot_cnt));
+  return (struct pool_entry *) (pool + (slot - disk_slot_cnt) * POOL_CHUNK);
+}
+
+/* Returns a free slot on the swap device, or SWAP_ERROR if there
+   is none.  Slots are handed out in order from a cluster of
+   SWAP_CLUSTER contiguous slots, so that successive evictions
+   write neighbouring sectors and page_swap_around() in vm/page.c
+   can read them back together.  Once no whole cluster is free,
+   single slots are used. */
+static size_t
+disk_alloc (void)
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  if (cluster_next == cluster_end)
+    {
+      cluster_next = bitmap_scan_and_flip (swap_map, 0, SWAP_CLUSTER, false);
+      cluster_end = cluster_next + SWAP_CLUSTER;
+      if (cluster_next == BITMAP_ERROR)
+        {
+          cluster_next = bitmap_scan_and_flip (swap_map, 0, 1, false);
+          cluster_end = cluster_next + 1;
+        }
+    }
+  if (cluster_next != BITMAP_ERROR)
+    slot = cluster_next++;
+  else
+    {
+      slot = SWAP_ERROR;
+      cluster_next = cluster_end = 0;
+    }
+  lock_release (&swap_lock);
+  return slot;
+}
+
+/* Writes the page at KPAGE to the swap pool or a free slot on
+   the swap device and returns the slot, or SWAP_ERROR if both
+   are full or missing. */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+  size_t i;
+
+  slot = pool_out (kpage);
+  if (slot != SWAP_ERROR)
+    return slot;
+
+  slot = disk_alloc ();
+  if (slot == SWAP_ERROR)
+    return SWAP_ERROR;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_block, slot * SECTORS_PER_SLOT + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  return slot;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and frees the
+   slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  struct pool_entry *e = pool_entry (slot);
+  size_t i;
+
+  if (e != NULL)
+    {
+      lz_decompress (e->data, e->size, kpage);
+      lock_acquire (&pool_lock);
+      pool_hit_cnt++;
+      lock_release (&pool_lock);
+    }
+  else
+    {
+      for (i = 0; i < SECTORS_PER_SLOT; i++)
+        block_read (swap_block, slot * SECTORS_PER_SLOT + i,
+                    (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+      lock_acquire (&swap_lock);
+      disk_in_cnt++;
+      lock_release (&swap_lock);
+    }
+  swap_free (slot);
+}
+
+/* Marks swap slot SLOT free without reading it. */
+void
+swap_free (size_t slot)
+{
+  struct pool_entry *e = pool_entry (slot);
+
+  if (e != NULL)
+    {
+      lock_acquire (&pool_lock);
+      bitmap_set_multiple (pool_map, slot - bitmap_size (swap_map),
+                           DIV_ROUND_UP (sizeof *e + e->size, POOL_CHUNK),
+                           false);
+      lock_release (&pool_lock);
+    }
+  else
+    {
+      lock_acquire (&swap_lock);
+      ASSERT (bitmap_test (swap_map, slot));
+      bitmap_reset (swap_map, slot);
+      lock_release (&swap_lock);
+    }
+}
+
+/* Returns true if slots SLOT and NEXT are both on the swap device
+   and NEXT is the slot DIR (1 or -1) places after SLOT, that is,
+   if reading NEXT right after SLOT is a sequential read. */
+bool
+swap_adjacent (size_t slot, size_t next, int dir)
+{
+  size_t disk_slot_cnt = bitmap_size (swap_map);
+
+  return (slot < disk_slot_cnt && next < disk_slot_cnt
+          && next == slot + dir);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  long long in_cnt = pool_hit_cnt + disk_in_cnt;
+  size_t used = 0, total = 0;
+
+  if (pool != NULL)
+    {
+      used = bitmap_count (pool_map, 0, bitmap_size (pool_map), true);
+      total = bitmap_size (pool_map);
+    }
+  printf ("Swap: %lld of %lld pages in from pool (%lld%%), "
+          "%lld pages compressed to %lld%%, "
+          "pool %zu of %zu kB in use\n",
+          pool_hit_cnt, in_cnt,
+          in_cnt > 0 ? pool_hit_cnt * 100 / in_cnt : 0,
+          pool_store_cnt,
+          pool_raw_bytes > 0 ? pool_packed_bytes * 100 / pool_raw_bytes : 0,
+          used * POOL_CHUNK / 1024, total * POOL_CHUNK / 1024);
+}
+
+/* Page compression.
+
+   A simple LZ77 variant.  The output is a sequence of groups,
+   each a flag byte followed by up to 8 items, one per flag bit
+   from least to most significant.  A clear bit is a literal
+   byte.  A set bit is a back-reference of 2 or 3 bytes: the low
+   12 bits of the first two bytes are the distance back to copy
+   from, the top 4 bits the length minus LZ_MIN_MATCH.  A length
+   field of 15 is followed by a byte to add to it.  References
+   may overlap the bytes they produce, so runs of one byte, like
+   the zeros that fill most user pages, take 3 bytes per
+   LZ_MAX_MATCH bytes of page. */
+
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15 + 255)
+#define LZ_HASH_BITS 12
+
+/* Most recent position, plus 1, of each hashed 3-byte sequence
+   in the page being compressed, or 0 if none. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+/* Hashes the 3 bytes at P. */
+static unsigned
+lz_hash (const uint8_t *p)
+{
+  unsigned x = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Compresses the page at SRC into DST, which has room for
+   DST_SIZE bytes.  Returns the compressed size, or 0 if it
+   would not fit.  Must be called with pool_lock held, because
+   it uses lz_table. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_size)
+{
+  uint8_t *flags = NULL;
+  size_t s = 0, d = 0;
+  int bit = 8;
+
+  ASSERT (lock_held_by_current_thread (&pool_lock));
+
+  memset (lz_table, 0, sizeof lz_table);
+  while (s < PGSIZE)
+    {
+      size_t len = 0, dist = 0;
+
+      if (bit == 8)
+        {
+          if (d >= dst_size)
+            return 0;
+          flags = &dst[d++];
+          *flags = 0;
+          bit = 0;
+        }
+
+      if (s + LZ_MIN_MATCH <= PGSIZE)
+        {
+          uint16_t *e = &lz_table[lz_hash (src + s)];
+          if (*e != 0)
+            {
+              size_t from = *e - 1;
+              dist = s - from;
+              while (len < LZ_MAX_MATCH && s + len < PGSIZE
+                     && src[from + len] == src[s + len])
+                len++;
+            }
+          *e = s + 1;
+        }
+
+      if (len >= LZ_MIN_MATCH)
+        {
+          size_t code = len - LZ_MIN_MATCH;
+          if (d + 3 > dst_size)
+            return 0;
+          *flags |= 1 << bit;
+          dst[d++] = dist & 0xff;
+          dst[d++] = (dist >> 8) | ((code < 15 ? code : 15) << 4);
+          if (code >= 15)
+            dst[d++] = code - 15;
+          s += len;
+        }
+      else
+        {
+          if (d >= dst_size)
+            return 0;
+          dst[d++] = src[s++];
+        }
+      bit++;
+    }
+  return d;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, produced by
+   lz_compress(), into the page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t src_size, uint8_t *dst)
+{
+  size_t s = 0, d = 0;
+  unsigned flags = 0;
+  int bit = 8;
+
+  while (d < PGSIZE)
+    {
+      if (bit == 8)
+        {
+          ASSERT (s < src_size);
+          flags = src[s++];
+          bit = 0;
+        }
+
+      if (flags & (1u << bit))
+        {
+          size_t dist, len;
+
+          ASSERT (s + 2 <= src_size);
+          dist = src[s] | ((src[s + 1] & 0x0f) << 8);
+          len = src[s + 1] >> 4;
+          s += 2;
+          if (len == 15)
+            len += src[s++];
+          len += LZ_MIN_MATCH;
+          ASSERT (dist > 0 && dist <= d && d + len <= PGSIZE);
+          for (; len > 0; len--, d++)
+            dst[d] = dst[d - dist];
+        }
+      else
+        {
+          ASSERT (s < src_size);
+          dst[d++] = src[s++];
+        }
+      bit++;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returned by swap_out() when no swap slot is free. */
+#define SWAP_ERROR SIZE_MAX
+
+/* Number of contiguous device slots reserved at a time, so that
+   pages evicted one after another land next to each other. */
+#define SWAP_CLUSTER 8
+
+/* Default for the -zp option: keep up to 128 kB of compressed
+   swap in memory. */
+#define SWAP_POOL_DEFAULT 32
+
+/* Number of kernel pages set aside for compressed swap.  0
+   sends every evicted page straight to the swap device. */
+extern size_t swap_pool_pages;
+
+void swap_init (void);
+size_t swap_out (const void *kpage);
+void swap_in (size_t slot, void *kpage);
+void swap_free (size_t slot);
+bool swap_adjacent (size_t slot, size_t next, int dir);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */